@@ -0,0 +1,744 @@
+#include "bimap.cpp"
+#include "btree_bimap.cpp"
+#include "compact_bimap.cpp"
+#include "concurrent_bimap.cpp"
+#include "flat_bimap.cpp"
+#include "mapped_bimap.cpp"
+#include "snapshot_bimap.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+template <class F> double measure_ns(F &&f) {
+    auto start = clock_type::now();
+    f();
+    return std::chrono::duration<double, std::nano>(clock_type::now() - start)
+            .count();
+}
+
+void report(char const *name, size_t n, size_t ops, double ns) {
+    std::printf("%-28s n=%-9zu %10.1f ns/op\n", name, n, ns / ops);
+}
+
+// Перцентили задержек отдельных операций.
+void report_latency(char const *name, size_t n, std::vector<double> &ns) {
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[static_cast<size_t>(q * (ns.size() - 1))]; };
+    std::printf("%-28s n=%-9zu p50 %8.1f  p99 %10.1f  max %12.1f ns\n", name, n,
+                at(0.5), at(0.99), ns.back());
+}
+
+// Аллокатор, считающий занятые через него байты.
+size_t allocated_bytes = 0;
+
+template <class T> struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() = default;
+    template <class U> counting_allocator(counting_allocator<U> const &) {}
+
+    T *allocate(size_t n) {
+        allocated_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n) {
+        allocated_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U> bool operator==(counting_allocator<U> const &) const { return true; }
+    template <class U> bool operator!=(counting_allocator<U> const &) const { return false; }
+};
+
+std::vector<int> shuffled(size_t n, std::mt19937 &rng) {
+    std::vector<int> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = static_cast<int>(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+// Вставка n пар, затем раунды erase + insert, затем разрушение.
+void bench_churn(size_t n) {
+    std::mt19937 rng(42);
+    std::vector<int> keys = shuffled(2 * n, rng);
+
+    auto *b = new bimap<int, int>;
+    double build = measure_ns([&] {
+        for (size_t i = 0; i < n; ++i) {
+            b->insert(keys[i], keys[i]);
+        }
+    });
+    report("insert", n, n, build);
+
+    double churn = measure_ns([&] {
+        for (size_t i = 0; i < n; ++i) {
+            b->erase_left(keys[i]);
+            b->insert(keys[n + i], keys[n + i]);
+            std::swap(keys[i], keys[n + i]);
+        }
+    });
+    report("erase+insert churn", n, n, churn);
+
+    double destroy = measure_ns([&] { delete b; });
+    report("destroy", n, n, destroy);
+}
+
+// Загрузка n случайных пар: insert по одной против конструктора от диапазона.
+void bench_bulk(size_t n) {
+    std::mt19937 rng(7);
+    std::vector<int> lefts = shuffled(n, rng);
+    std::vector<int> rights = shuffled(n, rng);
+    std::vector<std::pair<int, int>> pairs(n);
+    for (size_t i = 0; i < n; ++i) {
+        pairs[i] = {lefts[i], rights[i]};
+    }
+
+    double one_by_one = measure_ns([&] {
+        bimap<int, int> b;
+        for (auto const &p : pairs) {
+            b.insert(p.first, p.second);
+        }
+    });
+    report("load: insert loop", n, n, one_by_one);
+
+    double bulk = measure_ns([&] { bimap<int, int> b(pairs.begin(), pairs.end()); });
+    report("load: range constructor", n, n, bulk);
+
+    std::sort(pairs.begin(), pairs.end());
+    double sorted = measure_ns(
+            [&] { bimap<int, int> b(sorted_left, pairs.begin(), pairs.end()); });
+    report("load: sorted_left range", n, n, sorted);
+}
+
+// Удаление окна из 10% пар по left.
+void bench_range_erase(size_t n) {
+    std::mt19937 rng(11);
+    std::vector<int> rights = shuffled(n, rng);
+    std::vector<std::pair<int, int>> pairs(n);
+    for (size_t i = 0; i < n; ++i) {
+        pairs[i] = {static_cast<int>(i), rights[i]};
+    }
+    bimap<int, int> b(sorted_left, pairs.begin(), pairs.end());
+
+    int from = static_cast<int>(n / 4);
+    int to = from + static_cast<int>(n / 10);
+    double erase = measure_ns([&] {
+        b.erase_left(b.lower_bound_left(from), b.lower_bound_left(to));
+    });
+    report("range erase (10%)", n, n / 10, erase);
+}
+
+// Перенос k = n/10 пар с длинными строками из staging в live: копирование
+// со стиранием против извлечения узлов и merge.
+void bench_transfer(size_t n) {
+    using string_bimap = bimap<std::string, int>;
+    size_t k = n / 10;
+    std::mt19937 rng(5);
+    std::vector<int> keys = shuffled(n + k, rng);
+    auto name = [](int key) { return std::string(32, 'k') + std::to_string(key); };
+
+    auto fill = [&](string_bimap &live, string_bimap &staging) {
+        for (size_t i = 0; i < n; ++i) {
+            live.insert(name(keys[i]), keys[i]);
+        }
+        for (size_t i = n; i < n + k; ++i) {
+            staging.insert(name(keys[i]), keys[i]);
+        }
+    };
+
+    {
+        string_bimap live, staging;
+        fill(live, staging);
+        double copy = measure_ns([&] {
+            while (!staging.empty()) {
+                auto it = staging.begin_left();
+                live.insert(*it, *it.flip());
+                staging.erase_left(it);
+            }
+        });
+        report("transfer: insert+erase", n, k, copy);
+    }
+    {
+        string_bimap live, staging;
+        fill(live, staging);
+        double handles = measure_ns([&] {
+            while (!staging.empty()) {
+                live.insert(staging.extract_left(staging.begin_left()));
+            }
+        });
+        report("transfer: extract+insert", n, k, handles);
+    }
+    {
+        string_bimap live, staging;
+        fill(live, staging);
+        double merged = measure_ns([&] { live.merge(staging); });
+        report("transfer: merge", n, k, merged);
+    }
+}
+
+// Монотонно растущие left (например, id): задержки вставок и последующих
+// поисков по случайным left. Splay-дерево на таких ключах вырождается в
+// список, красно-черное остается сбалансированным.
+template <class Bimap> void bench_sequential(char const *name, size_t n) {
+    std::mt19937 rng(3);
+    std::vector<int> rights = shuffled(n, rng);
+    std::vector<double> ns;
+    ns.reserve(n);
+
+    Bimap b;
+    for (size_t i = 0; i < n; ++i) {
+        ns.push_back(measure_ns([&] { b.insert(static_cast<int>(i), rights[i]); }));
+    }
+    std::string title = std::string(name) + ": id insert";
+    report_latency(title.c_str(), n, ns);
+
+    ns.clear();
+    size_t found = 0;
+    for (size_t i = 0; i < std::min<size_t>(n, 300); ++i) {
+        int key = static_cast<int>(rng() % n);
+        ns.push_back(measure_ns([&] { found += b.find_left(key) != b.end_left(); }));
+    }
+    if (found == 0) {
+        std::printf("unreachable\n");
+    }
+    title = std::string(name) + ": id find";
+    report_latency(title.c_str(), n, ns);
+}
+
+// Поиски at_left по закону Ципфа (s = 1): ключ ранга r запрашивается с
+// вероятностью ~1/r, ранги раскиданы по ключам случайно.
+template <class Bimap> void bench_zipf(char const *name, size_t n) {
+    std::mt19937 rng(17);
+    std::vector<int> keys = shuffled(n, rng);
+    Bimap b;
+    for (int key : keys) {
+        b.insert(key, key);
+    }
+
+    std::vector<double> cdf(n);
+    double sum = 0;
+    for (size_t r = 0; r < n; ++r) {
+        sum += 1.0 / static_cast<double>(r + 1);
+        cdf[r] = sum;
+    }
+    size_t const lookups = 1000000;
+    std::vector<int> queries(lookups);
+    std::uniform_real_distribution<double> uniform(0, sum);
+    for (int &q : queries) {
+        size_t r = static_cast<size_t>(std::upper_bound(cdf.begin(), cdf.end(), uniform(rng)) -
+                                       cdf.begin());
+        q = keys[std::min(r, n - 1)];
+    }
+
+    long long total = 0;
+    double ns = measure_ns([&] {
+        for (int q : queries) {
+            total += b.at_left(q);
+        }
+    });
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+    std::string title = std::string(name) + ": zipf at_left";
+    report(title.c_str(), n, lookups, ns);
+}
+
+// Память на пару и поиск для пар "4-байтный id -> 8-байтный handle".
+template <class Bimap> void bench_memory(char const *name, size_t n) {
+    std::mt19937 rng(23);
+    std::vector<int> keys = shuffled(n, rng);
+    size_t before = allocated_bytes;
+    {
+        Bimap b;
+        for (int key : keys) {
+            b.insert(static_cast<std::uint32_t>(key), static_cast<std::uint64_t>(key) * 3);
+        }
+        std::printf("%-28s n=%-9zu %10.1f bytes/pair\n",
+                    (std::string(name) + ": memory").c_str(), n,
+                    static_cast<double>(allocated_bytes - before) / static_cast<double>(n));
+
+        std::shuffle(keys.begin(), keys.end(), rng);
+        std::uint64_t total = 0;
+        double ns = measure_ns([&] {
+            for (int key : keys) {
+                total += b.at_left(static_cast<std::uint32_t>(key));
+            }
+        });
+        if (total == 0) {
+            std::printf("unreachable\n");
+        }
+        report((std::string(name) + ": at_left").c_str(), n, n, ns);
+    }
+}
+
+// Построить один раз и много читать: загрузка n случайных пар диапазоном,
+// затем по n поисков at_left и at_right по случайным ключам.
+template <class Bimap> void bench_read_mostly(char const *name, size_t n) {
+    std::mt19937 rng(29);
+    std::vector<int> lefts = shuffled(n, rng);
+    std::vector<int> rights = shuffled(n, rng);
+    std::vector<std::pair<int, int>> pairs(n);
+    for (size_t i = 0; i < n; ++i) {
+        pairs[i] = {lefts[i], rights[i]};
+    }
+
+    Bimap *b = nullptr;
+    double build = measure_ns([&] { b = new Bimap(pairs.begin(), pairs.end()); });
+    report((std::string(name) + ": build").c_str(), n, n, build);
+
+    std::shuffle(lefts.begin(), lefts.end(), rng);
+    long long total = 0;
+    double left = measure_ns([&] {
+        for (int key : lefts) {
+            total += b->at_left(key);
+        }
+    });
+    report((std::string(name) + ": at_left").c_str(), n, n, left);
+
+    double right = measure_ns([&] {
+        for (int key : rights) {
+            total += b->at_right(key);
+        }
+    });
+    report((std::string(name) + ": at_right").c_str(), n, n, right);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+    delete b;
+}
+
+// Отображение 64-битных id в 32-битные: вставка n случайных пар, n поисков
+// at_left по случайным id и полный упорядоченный обход по left.
+template <class Bimap> void bench_ids(char const *name, size_t n) {
+    std::mt19937_64 rng(31);
+    std::vector<std::uint64_t> ids(n);
+    for (auto &id : ids) {
+        id = rng();
+    }
+    Bimap *b = new Bimap;
+    double insert = measure_ns([&] {
+        for (size_t i = 0; i < n; ++i) {
+            b->insert(ids[i], static_cast<std::uint32_t>(i));
+        }
+    });
+    report((std::string(name) + ": id insert").c_str(), n, n, insert);
+
+    std::shuffle(ids.begin(), ids.end(), rng);
+    std::uint64_t total = 0;
+    double lookup = measure_ns([&] {
+        for (std::uint64_t id : ids) {
+            total += b->at_left(id);
+        }
+    });
+    report((std::string(name) + ": id at_left").c_str(), n, n, lookup);
+
+    double scan = measure_ns([&] {
+        for (auto it = b->begin_left(); it != b->end_left(); ++it) {
+            total += *it;
+        }
+    });
+    report((std::string(name) + ": id scan").c_str(), n, n, scan);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+    delete b;
+}
+
+
+
+// Согласованный вид для отчета при работающем писателе: копия всего
+// bimap (как раньше под общей блокировкой) против publish() после k
+// изменений -- когда старый снимок уже отпущен (повтор журнала) и когда
+// его еще держит читатель (копирование при следующей записи).
+void bench_snapshot(size_t n, size_t k) {
+    std::mt19937 rng(41);
+    std::vector<int> keys = shuffled(n, rng);
+    snapshot_bimap<int, int> s;
+    bimap<int, int> plain;
+    for (int key : keys) {
+        s.insert(key, key);
+        plain.insert(key, key);
+    }
+    s.publish();
+
+    size_t const rounds = 20;
+    long long total = 0;
+    double copy = measure_ns([&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            bimap<int, int> view(plain);
+            total += static_cast<long long>(view.size());
+        }
+    });
+    report("snapshot: full copy", n, rounds, copy);
+
+    int next = static_cast<int>(n);
+    auto change = [&] {
+        for (size_t i = 0; i < k; ++i, ++next) {
+            s.erase_left(next - static_cast<int>(n));
+            s.insert(next, next);
+        }
+    };
+    double released = 0;
+    double held = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        released += measure_ns([&] {
+            change();
+            s.publish();
+        });
+        total += static_cast<long long>(s.snapshot()->size());
+    }
+    for (size_t r = 0; r < rounds; ++r) {
+        auto reader = s.snapshot();
+        held += measure_ns([&] {
+            change();
+            s.publish();
+        });
+        total += static_cast<long long>(reader->size());
+    }
+    std::string suffix = " (k=" + std::to_string(k) + ")";
+    report(("snapshot: k ops+publish" + suffix).c_str(), n, rounds, released);
+    report(("snapshot: held, k ops+pub" + suffix).c_str(), n, rounds, held);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+}
+
+// Пакет из k = min(n, 100000) случайных ключей (половина отсутствует):
+// find_left по одному, find_left_many на неупорядоченном и на
+// упорядоченном пакете.
+template <class Bimap> void bench_batch(char const *name, size_t n) {
+    std::mt19937 rng(43);
+    std::vector<int> keys = shuffled(2 * n, rng);
+    Bimap b;
+    for (size_t i = 0; i < n; ++i) {
+        b.insert(keys[i], static_cast<int>(i));
+    }
+    std::shuffle(keys.begin(), keys.end(), rng);
+    keys.resize(std::min<size_t>(n, 100000));
+    std::vector<typename Bimap::left_iterator> found(keys.size(), b.end_left());
+    Bimap const &view = b;
+
+    double single = measure_ns([&] {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            found[i] = view.find_left(keys[i]);
+        }
+    });
+    report((std::string(name) + ": find_left x k").c_str(), n, keys.size(), single);
+    double batched = measure_ns([&] { view.find_left_many(keys.begin(), keys.end(), found.begin()); });
+    report((std::string(name) + ": find_left_many").c_str(), n, keys.size(), batched);
+    std::sort(keys.begin(), keys.end());
+    double sorted = measure_ns([&] { view.find_left_many(keys.begin(), keys.end(), found.begin()); });
+    report((std::string(name) + ": find_left_many sorted").c_str(), n, keys.size(), sorted);
+}
+
+// Обходы: полный проход по left, копирование (обход обеих сторон) и
+// operator== на n парах, вставленных в случайном порядке, и begin_left()
+// после вставки возрастающих ключей (в splay-дереве -- длинная левая
+// ветвь после поиска максимума).
+template <class Bimap> void bench_scan(char const *name, size_t n) {
+    std::mt19937 rng(47);
+    std::vector<int> lefts = shuffled(n, rng);
+    std::vector<int> rights = shuffled(n, rng);
+    Bimap b;
+    for (size_t i = 0; i < n; ++i) {
+        b.insert(lefts[i], rights[i]);
+    }
+    long long total = 0;
+    double scan = measure_ns([&] {
+        for (auto it = b.begin_left(); it != b.end_left(); ++it) {
+            total += *it;
+        }
+    });
+    report((std::string(name) + ": scan left").c_str(), n, n, scan);
+
+    Bimap *copy = nullptr;
+    double copying = measure_ns([&] { copy = new Bimap(b); });
+    report((std::string(name) + ": copy").c_str(), n, n, copying);
+    double equal = measure_ns([&] { total += *copy == b; });
+    report((std::string(name) + ": operator==").c_str(), n, n, equal);
+    delete copy;
+
+    Bimap seq;
+    for (size_t i = 0; i < n; ++i) {
+        seq.insert(static_cast<int>(i), static_cast<int>(i));
+    }
+    std::as_const(seq).find_left(static_cast<int>(n - 1));
+    size_t const calls = 1000;
+    double begin = measure_ns([&] {
+        for (size_t i = 0; i < calls; ++i) {
+            total += *seq.begin_left();
+        }
+    });
+    report((std::string(name) + ": begin_left").c_str(), n, calls, begin);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+}
+
+// Перестройка на каждом цикле: новый bimap на цикл (узлы освобождаются
+// и выделяются заново) против clear() и вставки в тот же bimap.
+void bench_rebuild(size_t n) {
+    std::mt19937 rng(53);
+    std::vector<int> keys = shuffled(n, rng);
+    size_t const rounds = 5;
+    long long total = 0;
+    double fresh = measure_ns([&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            bimap<int, std::string> b;
+            for (int key : keys) {
+                b.insert(key, std::to_string(key));
+            }
+            total += static_cast<long long>(b.size());
+        }
+    });
+    report("rebuild: new bimap", n, n * rounds, fresh);
+    bimap<int, std::string> b;
+    double reused = measure_ns([&] {
+        for (size_t r = 0; r < rounds; ++r) {
+            b.clear();
+            for (int key : keys) {
+                b.insert(key, std::to_string(key));
+            }
+            total += static_cast<long long>(b.size());
+        }
+    });
+    report("rebuild: clear + insert", n, n * rounds, reused);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+}
+// Старт с готовыми данными: построение bimap вставками (как при разборе
+// текстового источника, без самого разбора) против снимка на диске --
+// открытие mapped_bimap, первые поиски в нем и load_bimap с проверкой
+// контрольной суммы. Файл только что записан и лежит в page cache.
+void bench_warm_start(size_t n) {
+    std::mt19937 rng(59);
+    std::vector<int> lefts = shuffled(n, rng);
+    std::vector<int> rights = shuffled(n, rng);
+    std::string const path =
+            (std::filesystem::temp_directory_path() / "bimap_bench.snapshot").string();
+    long long total = 0;
+    bimap<int, int> b;
+    double inserted = measure_ns([&] {
+        for (size_t i = 0; i < n; ++i) {
+            b.insert(lefts[i], rights[i]);
+        }
+    });
+    report("warm start: insert all", n, n, inserted);
+    double saved = measure_ns([&] { save_bimap(b, path); });
+    report("warm start: save_bimap", n, n, saved);
+    std::optional<mapped_bimap<int, int>> mapped;
+    double opened = measure_ns([&] { mapped.emplace(path); });
+    report("warm start: mapped open (1x)", n, 1, opened);
+    size_t const lookups = std::min<size_t>(n, 100000);
+    double found = measure_ns([&] {
+        for (size_t i = 0; i < lookups; ++i) {
+            total += mapped->at_left(lefts[i]);
+        }
+    });
+    report("warm start: mapped at_left", n, lookups, found);
+    double verified = measure_ns([&] { total += mapped->verify(); });
+    report("warm start: verify", n, n, verified);
+    mapped.reset();
+    double loaded = measure_ns([&] { total += load_bimap<bimap<int, int>>(path).size(); });
+    report("warm start: load_bimap", n, n, loaded);
+    std::filesystem::remove(path);
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+}
+
+// Репликация: b отличается от a на 1% пар (удаления, новые пары и смена
+// right). diff и apply против копирования b целиком; merge_union и
+// intersect -- на тех же a и b. Время на пару a.
+void bench_delta(size_t n) {
+    std::mt19937 rng(67);
+    std::vector<int> rights = shuffled(n, rng);
+    bimap<int, int> a;
+    for (size_t i = 0; i < n; ++i) {
+        a.insert(static_cast<int>(i), rights[i]);
+    }
+    bimap<int, int> b(a);
+    size_t const changes = std::max<size_t>(1, n / 100);
+    for (size_t i = 0; i < changes; ++i) {
+        int key = static_cast<int>(rng() % n);
+        switch (i % 3) {
+        case 0:
+            b.erase_left(key);
+            break;
+        case 1:
+            b.insert(static_cast<int>(n + i), static_cast<int>(n + i));
+            break;
+        default:
+            if (b.erase_left(key)) {
+                b.insert(key, static_cast<int>(2 * n + i));
+            }
+        }
+    }
+    long long total = 0;
+    bimap<int, int>::delta_type delta;
+    double diffed = measure_ns([&] { delta = diff(a, b); });
+    report("delta: diff (1% changed)", n, n, diffed);
+    bimap<int, int> replica(a);
+    double applied = measure_ns([&] { total += replica.apply(delta); });
+    report("delta: apply", n, n, applied);
+    double copied = measure_ns([&] {
+        bimap<int, int> full(b);
+        total += static_cast<long long>(full.size());
+    });
+    report("delta: full copy instead", n, n, copied);
+    double united = measure_ns([&] { total += static_cast<long long>(merge_union(a, b).size()); });
+    report("delta: merge_union", n, n, united);
+    double common = measure_ns([&] { total += static_cast<long long>(intersect(a, b).size()); });
+    report("delta: intersect", n, n, common);
+    if (total == 0 || replica != b) {
+        std::printf("unreachable\n");
+    }
+}
+
+// Один bimap под одним std::mutex -- то, что заменяет concurrent_bimap.
+template <class Left, class Right> struct locked_bimap {
+    template <class L, class R> bool insert(L &&left, R &&right) {
+        std::lock_guard lock(mutex);
+        return pairs.insert(std::forward<L>(left), std::forward<R>(right)) != pairs.end_left();
+    }
+
+    bool erase_left(Left const &left) {
+        std::lock_guard lock(mutex);
+        return pairs.erase_left(left);
+    }
+
+    std::optional<Right> find_left(Left const &left) {
+        std::lock_guard lock(mutex);
+        auto it = pairs.find_left(left);
+        if (it == pairs.end_left()) {
+            return std::nullopt;
+        }
+        return *it.flip();
+    }
+
+    std::mutex mutex;
+    bimap<Left, Right, hashed<>, hashed<>> pairs;
+};
+
+// Масштабирование по потокам: n пар заранее, затем каждый поток делает
+// ops операций: 90% find_left, 5% insert, 5% erase_left по случайным
+// ключам из [0, 2n). Время -- по часам стены на все операции всех потоков.
+template <class Map> void bench_concurrent(char const *name, size_t n, size_t ops) {
+    for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u, 64u}) {
+        Map map;
+        for (size_t i = 0; i < n; ++i) {
+            map.insert(static_cast<int>(2 * i), static_cast<int>(i));
+        }
+        std::vector<std::thread> workers;
+        std::atomic<long long> total{0};
+        double ns = measure_ns([&] {
+            for (unsigned t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    std::mt19937 rng(37 + t);
+                    long long local = 0;
+                    for (size_t i = 0; i < ops; ++i) {
+                        unsigned op = rng() % 20;
+                        int key = static_cast<int>(rng() % (2 * n));
+                        if (op == 0) {
+                            map.insert(key, key + static_cast<int>(2 * n));
+                        } else if (op == 1) {
+                            map.erase_left(key);
+                        } else if (auto found = map.find_left(key)) {
+                            local += *found;
+                        }
+                    }
+                    total += local;
+                });
+            }
+            for (auto &w : workers) {
+                w.join();
+            }
+        });
+        std::string label = std::string(name) + ": " + std::to_string(threads) + " threads";
+        report(label.c_str(), n, ops * threads, ns);
+        if (total == -1) {
+            std::printf("unreachable\n");
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    for (size_t n : {1000, 100000, 1000000}) {
+        bench_churn(n);
+        bench_bulk(n);
+        bench_range_erase(n);
+        bench_transfer(n);
+        bench_sequential<bimap<int, int>>("splay", n);
+        bench_sequential<bimap<int, int, std::less<int>, std::less<int>,
+                               std::allocator<std::pair<int, int>>, red_black>>(
+                "red_black", n);
+        bench_zipf<bimap<int, int>>("splay", n);
+        bench_zipf<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, splay_on_read<>>>(
+                "splay_on_read<1>", n);
+        bench_zipf<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, splay_on_read<16>>>(
+                "splay_on_read<16>", n);
+        bench_zipf<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, red_black>>("red_black", n);
+        using id_pair = std::pair<std::uint32_t, std::uint64_t>;
+        bench_memory<bimap<std::uint32_t, std::uint64_t, std::less<std::uint32_t>,
+                           std::less<std::uint64_t>, counting_allocator<id_pair>>>(
+                "bimap", n);
+        bench_memory<compact_bimap<std::uint32_t, std::uint64_t, std::less<std::uint32_t>,
+                                   std::less<std::uint64_t>, counting_allocator<id_pair>>>(
+                "compact_bimap", n);
+        bench_read_mostly<bimap<int, int>>("splay", n);
+        bench_read_mostly<bimap<int, int, std::less<int>, std::less<int>,
+                                std::allocator<std::pair<int, int>>, red_black>>(
+                "red_black", n);
+        bench_read_mostly<flat_bimap<int, int>>("flat_bimap", n);
+        bench_read_mostly<unordered_bimap<int, int>>("unordered_bimap", n);
+        bench_read_mostly<bimap<int, int, hashed<>, std::less<int>,
+                                std::allocator<std::pair<int, int>>, red_black>>(
+                "hashed/red_black", n);
+        bench_ids<bimap<std::uint64_t, std::uint32_t>>("splay", n);
+        bench_ids<bimap<std::uint64_t, std::uint32_t, std::less<std::uint64_t>,
+                        std::less<std::uint32_t>,
+                        std::allocator<std::pair<std::uint64_t, std::uint32_t>>, red_black>>(
+                "red_black", n);
+        bench_ids<bimap_for<std::uint64_t, std::uint32_t>>("btree_bimap", n);
+        bench_snapshot(n, 1000);
+        bench_batch<bimap<int, int>>("splay", n);
+        bench_batch<bimap<int, int, std::less<int>, std::less<int>,
+                          std::allocator<std::pair<int, int>>, red_black>>("red_black", n);
+        bench_batch<unordered_bimap<int, int>>("unordered_bimap", n);
+        bench_rebuild(n);
+        bench_warm_start(n);
+        bench_delta(n);
+        bench_scan<bimap<int, int>>("splay", n);
+        bench_scan<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, threaded>>("splay+threaded", n);
+        bench_scan<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, red_black>>("red_black", n);
+        bench_scan<bimap<int, int, std::less<int>, std::less<int>,
+                         std::allocator<std::pair<int, int>>, red_black, threaded>>(
+                "red_black+threaded", n);
+    }
+    bench_concurrent<locked_bimap<int, int>>("mutex+unordered_bimap", 1000000, 200000);
+    bench_concurrent<concurrent_bimap<int, int>>("concurrent_bimap", 1000000, 200000);
+}
@@ -1,14 +1,241 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Политики sorted_tree и bimap. Перечисляются в конце списка параметров:
+// bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>.
+// Без политики ее поля и код в узлы и операции не попадают.
+
+// Размеры поддеревьев в узлах: k-й элемент, ранг и число элементов в
+// диапазоне за O(log n).
+struct order_statistics {};
+
+// Балансировка красно-черным деревом вместо splay: высота не больше
+// 2 log n, вставка и удаление делают не больше трех поворотов, а поиск,
+// как и раньше, дерево не меняет. По умолчанию дерево splay.
+struct red_black {};
+
+// Узлы дополнительно связаны в кольцевой двусвязный список в порядке
+// обхода (фиктивный узел -- его голова): ++, -- и begin() за O(1) без
+// подъема по parent. Стоит двух указателей в узле на каждую сторону и
+// перевешивания соседей при вставке и удалении.
+struct threaded {};
+
+// Счетчики горячего пути: сравнения, повороты, длины путей splay, глубины
+// спусков поиска с гистограммой и аллокации пула узлов; читаются через
+// statistics(). Без политики счетчиков нет ни в объектах, ни в коде.
+struct instrumented {};
+
+// Поиск в неконстантном bimap (find_*, at_*) поднимает найденный узел в
+// корень splay-дерева на каждом Period-м обращении, так что часто
+// запрашиваемые ключи оказываются у корня. Такой поиск меняет дерево:
+// одновременные чтения без внешней синхронизации недопустимы. Поиск в
+// константном bimap дерево по-прежнему не трогает.
+template <unsigned Period = 1> struct splay_on_read {
+    static_assert(Period > 0);
+};
+
+template <class Policy, class... Policies>
+inline constexpr bool has_policy_v = (std::is_same_v<Policy, Policies> || ...);
+
+// Период splay_on_read из списка политик, 0 -- без splay при поиске.
+template <class... Policies> struct read_splay_period {
+    static constexpr unsigned value = 0;
+};
+
+template <unsigned Period, class... Policies>
+struct read_splay_period<splay_on_read<Period>, Policies...> {
+    static constexpr unsigned value = Period;
+};
+
+template <class Policy, class... Policies>
+struct read_splay_period<Policy, Policies...> : read_splay_period<Policies...> {};
+
+// Поля, которые политика добавляет в узел дерева.
+template <class Policy> struct policy_node_fields {};
+
+template <> struct policy_node_fields<order_statistics> {
+    size_t size = 1;
+};
+
+template <> struct policy_node_fields<red_black> {
+    bool red = false;
+};
+
+// Связи политики threaded: ссылаются на тип узла, поэтому не через
+// policy_node_fields.
+template <class Node, bool Threaded> struct thread_links {};
+
+template <class Node> struct thread_links<Node, true> {
+    Node *prev{};
+    Node *next{};
+};
+
+// Снимок счетчиков одного дерева (политика instrumented).
+struct tree_statistics {
+    static constexpr size_t histogram_size = 64;
+
+    std::uint64_t comparisons{};
+    std::uint64_t rotations{};
+    std::uint64_t splays{};
+    // Сумма длин путей splay: на сколько уровней поднимались узлы.
+    std::uint64_t splay_path{};
+    // Спуски от корня (locate, find, lower_bound, upper_bound, rank,
+    // пакетный поиск) и суммарное число пройденных ими узлов.
+    std::uint64_t descents{};
+    std::uint64_t descent_depth{};
+    std::uint64_t max_depth{};
+    // depth_histogram[d] -- спуски, прошедшие d узлов; последний элемент
+    // считает и все более глубокие.
+    std::uint64_t depth_histogram[histogram_size]{};
+};
+
+// Счетчик статистики. Приращение -- relaxed load и store без
+// read-modify-write: обычные mov без lock на x86. Константные поиски
+// можно вызывать одновременно (гонки данных нет), но одновременные
+// приращения могут теряться.
+struct stat_counter {
+    stat_counter() = default;
+    stat_counter(stat_counter const &) = delete;
+    stat_counter &operator=(stat_counter const &) = delete;
+
+    void add(std::uint64_t n) const {
+        _value.store(_value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void raise_to(std::uint64_t n) const {
+        if (_value.load(std::memory_order_relaxed) < n) {
+            _value.store(n, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint64_t get() const { return _value.load(std::memory_order_relaxed); }
+
+    void reset() { _value.store(0, std::memory_order_relaxed); }
+
+private:
+    mutable std::atomic<std::uint64_t> _value{};
+};
+
+// Счетчики sorted_tree. Без политики instrumented -- пустая база с
+// пустыми функциями, которые компилятор убирает вместе с аргументами.
+template <bool Measured> struct tree_counters {
+    void note_comparison() const {}
+    void note_rotation() const {}
+    void note_splay(size_t) const {}
+    void note_descent(size_t) const {}
+};
+
+template <> struct tree_counters<true> {
+    void note_comparison() const { _comparisons.add(1); }
+
+    void note_rotation() const { _rotations.add(1); }
+
+    void note_splay(size_t path) const {
+        _splays.add(1);
+        _splay_path.add(path);
+    }
+
+    void note_descent(size_t depth) const {
+        _descents.add(1);
+        _descent_depth.add(depth);
+        _max_depth.raise_to(depth);
+        _histogram[std::min(depth, tree_statistics::histogram_size - 1)].add(1);
+    }
+
+    tree_statistics statistics() const {
+        tree_statistics result;
+        result.comparisons = _comparisons.get();
+        result.rotations = _rotations.get();
+        result.splays = _splays.get();
+        result.splay_path = _splay_path.get();
+        result.descents = _descents.get();
+        result.descent_depth = _descent_depth.get();
+        result.max_depth = _max_depth.get();
+        for (size_t i = 0; i < tree_statistics::histogram_size; ++i) {
+            result.depth_histogram[i] = _histogram[i].get();
+        }
+        return result;
+    }
+
+    void reset_statistics() {
+        for (stat_counter *c : {&_comparisons, &_rotations, &_splays, &_splay_path, &_descents,
+                                &_descent_depth, &_max_depth}) {
+            c->reset();
+        }
+        for (stat_counter &c : _histogram) {
+            c.reset();
+        }
+    }
+
+private:
+    stat_counter _comparisons;
+    stat_counter _rotations;
+    stat_counter _splays;
+    stat_counter _splay_path;
+    stat_counter _descents;
+    stat_counter _descent_depth;
+    stat_counter _max_depth;
+    stat_counter _histogram[tree_statistics::histogram_size];
+};
+
+// Счетчик поисков политики splay_on_read: note_read() истинна на каждом
+// Period-м вызове. Без политики (Period == 0) -- пустая база.
+template <unsigned Period> struct read_counter {
+    bool note_read() {
+        if (++_reads != Period) {
+            return false;
+        }
+        _reads = 0;
+        return true;
+    }
+
+private:
+    unsigned _reads{};
+};
+
+template <> struct read_counter<0> {
+    bool note_read() { return false; }
+};
 
-template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
+template <class T, class tag, class Compare = std::less<T>, class... Policies>
+struct sorted_tree : private tree_counters<has_policy_v<instrumented, Policies...>>,
+                     private read_counter<read_splay_period<Policies...>::value> {
     using type = T;
 
-    struct node {
+    static constexpr bool counted = has_policy_v<order_statistics, Policies...>;
+    static constexpr bool colored = has_policy_v<red_black, Policies...>;
+    static constexpr unsigned read_period = read_splay_period<Policies...>::value;
+    static constexpr bool linked = has_policy_v<threaded, Policies...>;
+    static constexpr bool measured = has_policy_v<instrumented, Policies...>;
+    static_assert(!colored || read_period == 0,
+                  "splay_on_read requires a splay tree, not red_black");
+
+    // Отсутствующие дети -- nullptr. На фиктивный узел _dummy указывает только
+    // parent корня, а _dummy->left хранит сам корень, поэтому при перемещении
+    // дерева достаточно перевесить корень. С threaded _dummy->next и
+    // _dummy->prev -- первый и последний узлы (сам _dummy в пустом дереве).
+    struct node : policy_node_fields<Policies>..., thread_links<node, linked> {
+        // Значение создается из аргументов args.
+        template <class... Args>
+        explicit node(std::tuple<Args...> args)
+                : value(std::make_from_tuple<T>(std::move(args))) {}
+
         T value;
         node *parent{};
         node *left{};
@@ -39,7 +266,11 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
             if (_node == _end) {
                 return *this;
             }
-            if (_node->right == _end) {
+            if constexpr (linked) {
+                _node = _node->next;
+                return *this;
+            }
+            if (_node->right == nullptr) {
                 while (_node->parent->right == _node) {
                     _node = _node->parent;
                 }
@@ -47,7 +278,7 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
             } else {
                 _node = _node->right;
 
-                while (_node->left != _end) {
+                while (_node->left != nullptr) {
                     _node = _node->left;
                 }
             }
@@ -65,14 +296,18 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
         // Декремент итератора begin_left() неопределен.
         // Декремент невалидного итератора неопределен.
         iterator &operator--() {
-            if (_node->left == _end) {
+            if constexpr (linked) {
+                _node = _node->prev;
+                return *this;
+            }
+            if (_node->left == nullptr) {
                 while (_node->parent->left == _node) {
                     _node = _node->parent;
                 }
                 _node = _node->parent;
             } else {
                 _node = _node->left;
-                while (_node->right != _end) {
+                while (_node->right != nullptr) {
                     _node = _node->right;
                 }
             }
@@ -91,31 +326,210 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
     };
 
     explicit sorted_tree(node *dummy, Compare compare = Compare())
-            : _dummy(dummy), _comparator(compare) {}
+            : _dummy(dummy), _comparator(compare) {
+        _dummy->parent = _dummy;
+        _dummy->left = nullptr;
+        _dummy->right = nullptr;
+        if constexpr (linked) {
+            _dummy->prev = _dummy->next = _dummy;
+        }
+    }
+
+    // Конструктор, общий с hashed_index: дереву аллокатор не нужен, узлы
+    // выделяет bimap.
+    template <class Alloc>
+    sorted_tree(node *dummy, Compare compare, Alloc const &)
+            : sorted_tree(dummy, std::move(compare)) {}
+
+    // Место в дереве, найденное одним спуском. Если значение уже есть,
+    // found == true и parent указывает на него, иначе новый узел нужно
+    // подвесить к parent (к _dummy в пустом дереве) слева или справа.
+    struct position {
+        node *parent;
+        bool left;
+        bool found;
+    };
+
+    // Место сразу перед next (_dummy -- в конце дерева), без сравнений.
+    position before(node *next) const {
+        if (next->left == nullptr) {
+            return {next, true, false};
+        }
+        node *p = next->left;
+        while (p->right != nullptr) {
+            p = p->right;
+        }
+        return {p, false, false};
+    }
+
+    position locate(type const &value) const {
+        node *parent = _dummy;
+        bool left = true;
+        size_t depth = 0;
+        for (node *curr = _dummy->left; curr != nullptr; ++depth) {
+            if (less(value, curr->value)) {
+                parent = curr;
+                left = true;
+                curr = curr->left;
+            } else if (less(curr->value, value)) {
+                parent = curr;
+                left = false;
+                curr = curr->right;
+            } else {
+                this->note_descent(depth + 1);
+                return {curr, false, true};
+            }
+        }
+        this->note_descent(depth);
+        return {parent, left, false};
+    }
 
-    iterator insert(node *node) {
-        if (_dummy->left == _dummy) {
-            _dummy->left = node;
+    // Подвешивает node в место pos, полученное locate без изменений дерева
+    // после него, и поднимает его в корень (в красно-черном дереве --
+    // восстанавливает раскраску).
+    iterator insert(position pos, node *node) {
+        if constexpr (counted) {
+            node->size = 1;
+            for (auto *p = pos.parent; p != _dummy; p = p->parent) {
+                ++p->size;
+            }
+        }
+        node->parent = pos.parent;
+        node->left = nullptr;
+        node->right = nullptr;
+        if (pos.left) {
+            pos.parent->left = node;
+        } else {
+            pos.parent->right = node;
+        }
+        if constexpr (linked) {
+            // Левый ребенок идет прямо перед родителем, правый -- сразу
+            // после; пустое дерево подвешивает узел слева к _dummy.
+            link_after(pos.left ? pos.parent->prev : pos.parent, node);
+        }
+        if constexpr (colored) {
+            rebalance_after_insert(node);
         } else {
-            add(_dummy->left, node);
-            _dummy->left = node;
+            splay(node);
         }
         ++_node_count;
         return iterator{node, _dummy};
     }
 
-    iterator find(type const &value) const {
-        node *curr = _dummy->left;
-        while (curr != _dummy && (_comparator(curr->value, value) ||
-                                  _comparator(value, curr->value))) {
-            if (_comparator(value, curr->value)) {
+    // Значения node в дереве быть не должно.
+    iterator insert(node *node) { return insert(locate(node->value), node); }
+
+    // Заменяет значение n на value (его в дереве быть не должно) и
+    // переставляет n на новое место. Место ищется до изменений: если
+    // компаратор бросит, дерево не меняется. Если бросит присваивание
+    // значения, n возвращается на прежнее место без сравнений (значение n
+    // тогда -- какое оставило присваивание).
+    void relink(node *n, type &&value) {
+        node *next = _dummy;
+        for (node *curr = _dummy->left; curr != nullptr;) {
+            if (less(value, curr->value)) {
+                next = curr;
                 curr = curr->left;
             } else {
                 curr = curr->right;
             }
         }
+        node *const old_next = erase(n)._node;
+        if (next == n) {
+            next = old_next;
+        }
+        try {
+            n->value = std::move(value);
+        } catch (...) {
+            insert(before(old_next), n);
+            throw;
+        }
+        insert(before(next), n);
+    }
 
-        return iterator{curr, _dummy};
+    // Поиск принимает любой K, сравнимый компаратором со значениями дерева:
+    // для прозрачных компараторов (с is_transparent) bimap пропускает сюда
+    // ключи других типов без создания временного type.
+    template <class K> iterator find(K const &value) const {
+        iterator it = lower_bound(value);
+        if (it._node != _dummy && less(value, it._node->value)) {
+            return end();
+        }
+        return it;
+    }
+
+    // Поиск с splay найденного узла в режиме splay_on_read.
+    template <class K> iterator find(K const &value) {
+        iterator it = std::as_const(*this).find(value);
+        if constexpr (read_period != 0) {
+            if (it._node != _dummy && this->note_read()) {
+                splay(it._node);
+            }
+        }
+        return it;
+    }
+
+    // Пакетный поиск ключей [first, last), emit(iterator) вызывается для
+    // каждого ключа по порядку. Дерево не меняется и при splay_on_read.
+    // Упорядоченные ключи ищутся от предыдущего найденного места (finger
+    // search): подъем до общего предка и спуск, O(k log(n / k)) на k
+    // ключей в сбалансированном дереве. Остальные -- группами по
+    // batch_lanes спусков, идущих вперемешку: пока один спуск ждет узел из
+    // памяти, остальные делают свои шаги, а следующий узел каждого
+    // загружается заранее.
+    // Finger search -- цепочка зависимых переходов по parent и детям, без
+    // перекрытия промахов кэша, поэтому выигрывает, только если дерево
+    // помещается в кэш или пакет плотнее дерева (k >= 2n); иначе и
+    // упорядоченный пакет ищется спусками вперемешку.
+    template <class It, class Emit> void find_many(It first, It last, Emit emit) const {
+        if (std::is_sorted(first, last, _comparator) &&
+            (_node_count <= finger_max_size ||
+             static_cast<size_t>(std::distance(first, last)) >= 2 * _node_count)) {
+            node *finger = nullptr;
+            for (; first != last; ++first) {
+                finger = finger == nullptr ? lower_bound(*first)._node
+                                           : lower_bound_from(finger, *first);
+                emit(equal_or_end(finger, *first));
+            }
+            return;
+        }
+        while (first != last) {
+            using key_ptr = decltype(std::addressof(*first));
+            key_ptr keys[batch_lanes];
+            node *curr[batch_lanes];
+            node *result[batch_lanes];
+            size_t depth[batch_lanes];
+            size_t lanes = 0;
+            for (; lanes < batch_lanes && first != last; ++lanes, ++first) {
+                keys[lanes] = std::addressof(*first);
+                curr[lanes] = _dummy->left;
+                result[lanes] = _dummy;
+                depth[lanes] = 0;
+            }
+            for (size_t active = lanes; active != 0;) {
+                active = 0;
+                for (size_t i = 0; i < lanes; ++i) {
+                    if (curr[i] == nullptr) {
+                        continue;
+                    }
+                    ++depth[i];
+                    if (less(curr[i]->value, *keys[i])) {
+                        curr[i] = curr[i]->right;
+                    } else {
+                        result[i] = curr[i];
+                        curr[i] = curr[i]->left;
+                    }
+                    if (curr[i] != nullptr) {
+                        __builtin_prefetch(curr[i]);
+                        ++active;
+                    }
+                }
+            }
+            for (size_t i = 0; i < lanes; ++i) {
+                this->note_descent(depth[i]);
+                emit(equal_or_end(result[i], *keys[i]));
+            }
+        }
     }
 
     iterator erase(node *n) {
@@ -123,13 +537,95 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
         return iterator{remove(n), _dummy};
     }
 
-    iterator lower_bound(T const &value) const {
-        return {lower_bound(_dummy->left, value), _dummy};
+    template <class K> iterator lower_bound(K const &value) const {
+        node *result = _dummy;
+        size_t depth = 0;
+        for (node *curr = _dummy->left; curr != nullptr; ++depth) {
+            if (less(curr->value, value)) {
+                curr = curr->right;
+            } else {
+                result = curr;
+                curr = curr->left;
+            }
+        }
+        this->note_descent(depth);
+        return iterator{result, _dummy};
+    }
+
+    // lower_bound(value) при известном finger = lower_bound(prev), prev <=
+    // value. Подъем от finger идет, пока value не окажется левее предка, в
+    // правом поддереве которого лежит путь: все, что между, меньше value.
+    template <class K> node *lower_bound_from(node *finger, K const &value) const {
+        if (finger == _dummy || !less(finger->value, value)) {
+            return finger;
+        }
+        node *curr = finger;
+        node *result = _dummy;
+        while (curr->parent != _dummy) {
+            node *parent = curr->parent;
+            if (parent->left == curr && !less(parent->value, value)) {
+                result = parent;
+                break;
+            }
+            curr = parent;
+        }
+        for (curr = curr->right; curr != nullptr;) {
+            if (less(curr->value, value)) {
+                curr = curr->right;
+            } else {
+                result = curr;
+                curr = curr->left;
+            }
+        }
+        return result;
+    }
+
+    // Функции ниже требуют политики order_statistics.
+    // Константные перегрузки дерево не меняют и в splay-дереве стоят
+    // O(глубины), то есть до O(n) после вставок по возрастанию.
+    // Неконстантные поднимают последний пройденный узел в корень
+    // splay-дерева, как поиск при splay_on_read, что дает амортизированные
+    // O(log n); в красно-черном дереве они совпадают с константными.
+
+    // k-й по порядку элемент (с нуля) или end(), если k >= size().
+    iterator nth(size_t k) const { return iterator{nth_descent(k).first, _dummy}; }
+
+    iterator nth(size_t k) {
+        auto [found, last] = nth_descent(k);
+        splay_reached(last);
+        return iterator{found, _dummy};
+    }
+
+    // Число элементов, меньших value (позиция lower_bound(value)).
+    template <class K> size_t rank(K const &value) const { return rank_descent(value).first; }
+
+    template <class K> size_t rank(K const &value) {
+        auto [result, last] = rank_descent(value);
+        splay_reached(last);
+        return result;
+    }
+
+    template <class K> iterator upper_bound(K const &value) const {
+        node *result = _dummy;
+        size_t depth = 0;
+        for (node *curr = _dummy->left; curr != nullptr; ++depth) {
+            if (less(value, curr->value)) {
+                result = curr;
+                curr = curr->left;
+            } else {
+                curr = curr->right;
+            }
+        }
+        this->note_descent(depth);
+        return iterator{result, _dummy};
     }
 
     iterator begin() const {
-        node *curr = _dummy->left;
-        while (curr->left != _dummy) {
+        if constexpr (linked) {
+            return iterator{_dummy->next, _dummy};
+        }
+        node *curr = _dummy;
+        while (curr->left != nullptr) {
             curr = curr->left;
         }
         return iterator{curr, _dummy};
@@ -137,119 +633,228 @@ template <class T, class tag, class Compare = std::less<T>> struct sorted_tree {
 
     iterator end() const { return iterator{_dummy, _dummy}; }
 
-    Compare comparator() const { return _comparator; }
+    Compare const &comparator() const { return _comparator; }
+    Compare &comparator() { return _comparator; }
 
     size_t size() const { return _node_count; }
 
-private:
-    node *remove(node *remove_node) {
-        splay(remove_node);
-        iterator it{remove_node, _dummy};
-        ++it;
-        remove_node->left->parent = _dummy;
-        remove_node->right->parent = _dummy;
-        _dummy->left = merge(remove_node->left, remove_node->right);
-        remove_node->left = _dummy;
-        remove_node->right = _dummy;
-        remove_node->parent = _dummy;
-        return it._node;
+    // Память индекса сверх узлов: у дерева все лежит в узлах.
+    size_t memory_usage() const { return 0; }
+
+    // Снимок и сброс счетчиков, требуют политики instrumented. Счетчики
+    // принадлежат объекту дерева: swap их не переносит.
+    tree_statistics statistics() const {
+        static_assert(measured, "statistics requires the instrumented policy");
+        return counters::statistics();
+    }
+
+    void reset_statistics() {
+        static_assert(measured, "reset_statistics requires the instrumented policy");
+        counters::reset_statistics();
     }
 
-    void add(node *tree, node *insert_node) {
-        insert_node->parent = tree->parent;
-        tree->parent = _dummy;
-        std::pair<node *, node *> trees = split(tree, insert_node->value);
-        insert_node->left = trees.first;
-        insert_node->right = trees.second;
-        if (trees.first != _dummy) {
-            trees.first->parent = insert_node;
+    // Перестраивает дерево в сбалансированное из узлов [first, last), уже
+    // упорядоченных по возрастанию. Прежняя структура отбрасывается, поэтому
+    // в диапазон должны входить все узлы дерева. Компаратор не вызывается.
+    // Красными красятся узлы нижнего уровня: все уровни выше заполнены.
+    template <class It> void build(It first, It last) {
+        _node_count = static_cast<size_t>(last - first);
+        size_t red_depth = 0;
+        while ((size_t{2} << red_depth) <= _node_count) {
+            ++red_depth;
+        }
+        _dummy->left = build(first, last, _dummy, 0, red_depth);
+        if constexpr (linked) {
+            node *prev = _dummy;
+            for (; first != last; ++first) {
+                node *n = *first;
+                prev->next = n;
+                n->prev = prev;
+                prev = n;
+            }
+            prev->next = _dummy;
+            _dummy->prev = prev;
         }
-        if (trees.second != _dummy) {
-            trees.second->parent = insert_node;
+        if constexpr (colored) {
+            if (_dummy->left != nullptr) {
+                _dummy->left->red = false;
+            }
         }
     }
 
-    node *merge(node *tree1, node *tree2) {
-        if (tree1 == _dummy) {
-            return tree2;
+    // Вырезает узлы [first, last) (их count штук) двумя splay и одним merge.
+    // Красно-черное дерево удаляет их по одному.
+    // Связи внутри вырезанных узлов после этого не определены.
+    void cut(node *first, node *last, size_t count) {
+        if constexpr (colored) {
+            while (first != last) {
+                first = remove(first);
+            }
+            _node_count -= count;
+            return;
+        }
+        if constexpr (linked) {
+            node *before = first->prev;
+            before->next = last;
+            last->prev = before;
+        }
+        splay(first);
+        node *before = first->left;
+        if (before != nullptr) {
+            before->parent = _dummy;
         }
+        first->left = nullptr;
+        recount(first);
+
+        node *after = nullptr;
+        if (last != _dummy) {
+            splay(last);
+            last->left = nullptr;
+            recount(last);
+            after = last;
+        }
+        _dummy->left = merge(before, after);
+        _node_count -= count;
+    }
 
-        if (tree2 == _dummy) {
-            return tree1;
+    // Забывает все узлы, сами узлы не трогает.
+    void clear() noexcept {
+        _dummy->left = nullptr;
+        if constexpr (linked) {
+            _dummy->prev = _dummy->next = _dummy;
         }
+        _node_count = 0;
+    }
 
-        while (tree1->right != _dummy) {
-            tree1 = tree1->right;
+    // Обменивается содержимым с other, перевешивая только корни.
+    void swap(sorted_tree &other) noexcept(std::is_nothrow_swappable_v<Compare>) {
+        std::swap(_dummy->left, other._dummy->left);
+        if (_dummy->left != nullptr) {
+            _dummy->left->parent = _dummy;
         }
-        splay(tree1);
-        tree1->right = tree2;
-        tree2->parent = tree1;
-        return tree1;
+        if (other._dummy->left != nullptr) {
+            other._dummy->left->parent = other._dummy;
+        }
+        if constexpr (linked) {
+            std::swap(_dummy->next, other._dummy->next);
+            std::swap(_dummy->prev, other._dummy->prev);
+            adopt_list(other._dummy);
+            other.adopt_list(_dummy);
+        }
+        using std::swap;
+        swap(_comparator, other._comparator);
+        std::swap(_node_count, other._node_count);
     }
 
-    node *lower_bound(node *tree, T const &value) const {
-        node *curr = tree;
-        while (curr != _dummy && (_comparator(curr->value, value) ||
-                                  _comparator(value, curr->value))) {
-            if (_comparator(value, curr->value)) {
-                if (curr->left == _dummy) {
-                    break;
-                }
-                curr = curr->left;
-            } else {
-                if (curr->right == _dummy) {
-                    break;
-                }
-                curr = curr->right;
-            }
+private:
+    using counters = tree_counters<measured>;
+
+    // Вызов компаратора, который считает политика instrumented.
+    template <class A, class B> bool less(A const &a, B const &b) const {
+        this->note_comparison();
+        return _comparator(a, b);
+    }
+
+    template <class It>
+    node *build(It first, It last, node *parent, size_t depth, size_t red_depth) {
+        if (first == last) {
+            return nullptr;
+        }
+        It mid = first + (last - first) / 2;
+        node *root = *mid;
+        root->parent = parent;
+        root->left = build(first, mid, root, depth + 1, red_depth);
+        root->right = build(mid + 1, last, root, depth + 1, red_depth);
+        if constexpr (counted) {
+            root->size = static_cast<size_t>(last - first);
+        }
+        if constexpr (colored) {
+            root->red = depth == red_depth;
+        }
+        return root;
+    }
+
+    static size_t subtree_size(node *n) { return n == nullptr ? 0 : n->size; }
+
+    // Вставляет n в список сразу после prev.
+    static void link_after(node *prev, node *n) {
+        n->prev = prev;
+        n->next = prev->next;
+        prev->next->prev = n;
+        prev->next = n;
+    }
+
+    // После обмена концами списков с деревом other_dummy концы списка
+    // ссылаются на чужой фиктивный узел.
+    void adopt_list(node *other_dummy) {
+        if (_dummy->next == other_dummy) {
+            _dummy->next = _dummy->prev = _dummy;
+        } else {
+            _dummy->next->prev = _dummy;
+            _dummy->prev->next = _dummy;
         }
+    }
 
-        iterator it{curr, _dummy};
+    // Пересчитывает размер n по детям. Без order_statistics ничего не делает.
+    static void recount(node *n) {
+        if constexpr (counted) {
+            n->size = 1 + subtree_size(n->left) + subtree_size(n->right);
+        }
+    }
 
-        if (_comparator(curr->value, value)) {
+    node *remove(node *remove_node) {
+        if constexpr (linked) {
+            remove_node->prev->next = remove_node->next;
+            remove_node->next->prev = remove_node->prev;
+        }
+        if constexpr (colored) {
+            iterator it{remove_node, _dummy};
             ++it;
+            rebalanced_remove(remove_node);
+            remove_node->left = nullptr;
+            remove_node->right = nullptr;
+            remove_node->parent = nullptr;
+            return it._node;
         }
-
+        splay(remove_node);
+        iterator it{remove_node, _dummy};
+        ++it;
+        if (remove_node->left != nullptr) {
+            remove_node->left->parent = _dummy;
+        }
+        if (remove_node->right != nullptr) {
+            remove_node->right->parent = _dummy;
+        }
+        _dummy->left = merge(remove_node->left, remove_node->right);
+        remove_node->left = nullptr;
+        remove_node->right = nullptr;
+        remove_node->parent = nullptr;
         return it._node;
     }
 
-    std::pair<node *, node *> split(node *tree, T const &value) {
-        node *curr = tree;
-        while (curr != _dummy && (_comparator(curr->value, value) ||
-                                  _comparator(value, curr->value))) {
-            if (_comparator(value, curr->value)) {
-                if (curr->left == _dummy) {
-                    break;
-                }
-                curr = curr->left;
-            } else {
-                if (curr->right == _dummy) {
-                    break;
-                }
-                curr = curr->right;
-            }
+    node *merge(node *tree1, node *tree2) {
+        if (tree1 == nullptr) {
+            return tree2;
         }
 
-        splay(curr);
+        if (tree2 == nullptr) {
+            return tree1;
+        }
 
-        if (_comparator(curr->value, value)) {
-            node *temp = curr->right;
-            if (temp != _dummy) {
-                temp->parent = _dummy;
-            }
-            curr->right = _dummy;
-            return {curr, temp};
-        } else {
-            node *temp = curr->left;
-            if (temp != _dummy) {
-                temp->parent = _dummy;
-            }
-            curr->left = _dummy;
-            return {temp, curr};
+        // splay поворачивает корень через _dummy->left.
+        _dummy->left = tree1;
+        while (tree1->right != nullptr) {
+            tree1 = tree1->right;
         }
+        splay(tree1);
+        tree1->right = tree2;
+        tree2->parent = tree1;
+        recount(tree1);
+        return tree1;
     }
 
     node *rotate_left(node *v) {
+        this->note_rotation();
         node *p = v->parent;
         node *r = v->right;
         if (p->left == v) {
@@ -263,14 +868,17 @@ private:
         v->right = tmp;
         v->parent = r;
         r->parent = p;
-        if (v->right != _dummy) {
+        if (v->right != nullptr) {
             v->right->parent = v;
         }
+        recount(v);
+        recount(r);
 
         return v;
     }
 
     node *rotate_right(node *v) {
+        this->note_rotation();
         node *p = v->parent;
         node *l = v->left;
         if (p->left == v) {
@@ -284,15 +892,69 @@ private:
         v->left = tmp;
         v->parent = l;
         l->parent = p;
-        if (v->left != _dummy) {
+        if (v->left != nullptr) {
             v->left->parent = v;
         }
+        recount(v);
+        recount(l);
 
         return v;
     }
 
+    // Спуск nth: найденный узел (или _dummy) и последний пройденный узел.
+    std::pair<node *, node *> nth_descent(size_t k) const {
+        static_assert(counted, "nth requires the order_statistics policy");
+        node *last = nullptr;
+        size_t depth = 0;
+        for (node *curr = _dummy->left; curr != nullptr; ++depth) {
+            last = curr;
+            size_t left_size = subtree_size(curr->left);
+            if (k < left_size) {
+                curr = curr->left;
+            } else if (k == left_size) {
+                this->note_descent(depth + 1);
+                return {curr, curr};
+            } else {
+                k -= left_size + 1;
+                curr = curr->right;
+            }
+        }
+        this->note_descent(depth);
+        return {_dummy, last};
+    }
+
+    // Спуск rank: ответ и последний пройденный узел.
+    template <class K> std::pair<size_t, node *> rank_descent(K const &value) const {
+        static_assert(counted, "rank requires the order_statistics policy");
+        size_t result = 0;
+        node *last = nullptr;
+        size_t depth = 0;
+        for (node *curr = _dummy->left; curr != nullptr; ++depth) {
+            last = curr;
+            if (less(curr->value, value)) {
+                result += subtree_size(curr->left) + 1;
+                curr = curr->right;
+            } else {
+                curr = curr->left;
+            }
+        }
+        this->note_descent(depth);
+        return {result, last};
+    }
+
+    // Splay узла, до которого дошел спуск nth/rank (nullptr -- пустое дерево).
+    void splay_reached(node *last) {
+        if constexpr (!colored) {
+            if (last != nullptr) {
+                splay(last);
+            }
+        }
+    }
+
     void splay(node *v) {
+        size_t path = 0;
         while (v->parent != _dummy) {
+            path += v->parent->parent == _dummy ? 1 : 2;
             if (v == v->parent->left) {
                 if (v->parent->parent == _dummy) {
                     rotate_right(v->parent);
@@ -315,41 +977,651 @@ private:
                 }
             }
         }
+        this->note_splay(path);
     }
 
-    void normalise(node *n) {
-        if (n != _dummy) {
-            if (n->left != _dummy) {
-                n->left->parent = n;
-            }
-            if (n->right != _dummy) {
-                n->right->parent = n;
-            }
+    static bool is_red(node *n) { return n != nullptr && n->red; }
+
+    // Заменяет ребенка old узла parent (или корень, если parent == _dummy).
+    static void replace_child(node *parent, node *old, node *child) {
+        if (parent->left == old) {
+            parent->left = child;
+        } else {
+            parent->right = child;
         }
     }
 
-    node *const _dummy;
-    Compare _comparator;
-    size_t _node_count{};
-};
-
-template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
-        typename CompareRight = std::less<Right>>
-struct bimap {
-    struct left_tag;
-    struct right_tag;
+    void rebalance_after_insert(node *x) {
+        x->red = true;
+        while (x->parent != _dummy && x->parent->red) {
+            // Красный отец -- не корень, поэтому дед существует.
+            node *p = x->parent;
+            node *g = p->parent;
+            if (p == g->left) {
+                node *uncle = g->right;
+                if (is_red(uncle)) {
+                    p->red = uncle->red = false;
+                    g->red = true;
+                    x = g;
+                    continue;
+                }
+                if (x == p->right) {
+                    rotate_left(p);
+                    p = x;
+                }
+                p->red = false;
+                g->red = true;
+                rotate_right(g);
+                break;
+            } else {
+                node *uncle = g->left;
+                if (is_red(uncle)) {
+                    p->red = uncle->red = false;
+                    g->red = true;
+                    x = g;
+                    continue;
+                }
+                if (x == p->left) {
+                    rotate_right(p);
+                    p = x;
+                }
+                p->red = false;
+                g->red = true;
+                rotate_left(g);
+                break;
+            }
+        }
+        _dummy->left->red = false;
+    }
 
-    using left_tree = sorted_tree<Left, left_tag, CompareLeft>;
-    using right_tree = sorted_tree<Right, right_tag, CompareRight>;
+    // Удаление z из красно-черного дерева. Значения узлов менять нельзя
+    // (узел общий для двух деревьев), поэтому если у z два ребенка, на его
+    // место перевешивается сам следующий узел y.
+    void rebalanced_remove(node *z) {
+        node *y = z;
+        node *x;
+        node *x_parent;
+        if (z->left == nullptr) {
+            x = z->right;
+        } else if (z->right == nullptr) {
+            x = z->left;
+        } else {
+            y = z->right;
+            while (y->left != nullptr) {
+                y = y->left;
+            }
+            x = y->right;
+        }
 
-    using left_t = Left;
-    using right_t = Right;
+        bool removed_red;
+        if (y != z) {
+            z->left->parent = y;
+            y->left = z->left;
+            if (y != z->right) {
+                x_parent = y->parent;
+                if (x != nullptr) {
+                    x->parent = x_parent;
+                }
+                x_parent->left = x;
+                y->right = z->right;
+                z->right->parent = y;
+            } else {
+                x_parent = y;
+            }
+            replace_child(z->parent, z, y);
+            y->parent = z->parent;
+            removed_red = y->red;
+            y->red = z->red;
+        } else {
+            x_parent = z->parent;
+            if (x != nullptr) {
+                x->parent = x_parent;
+            }
+            replace_child(x_parent, z, x);
+            removed_red = z->red;
+        }
+
+        if constexpr (counted) {
+            for (node *p = x_parent; p != _dummy; p = p->parent) {
+                recount(p);
+            }
+        }
+        if (!removed_red) {
+            rebalance_after_remove(x, x_parent);
+        }
+    }
+
+    // x занял место удаленного черного узла, и на путях через x черных
+    // узлов на один меньше. У x_parent второй ребенок w существует.
+    void rebalance_after_remove(node *x, node *x_parent) {
+        while (x != _dummy->left && !is_red(x)) {
+            if (x == x_parent->left) {
+                node *w = x_parent->right;
+                if (w->red) {
+                    w->red = false;
+                    x_parent->red = true;
+                    rotate_left(x_parent);
+                    w = x_parent->right;
+                }
+                if (!is_red(w->left) && !is_red(w->right)) {
+                    w->red = true;
+                    x = x_parent;
+                    x_parent = x->parent;
+                    continue;
+                }
+                if (!is_red(w->right)) {
+                    w->left->red = false;
+                    w->red = true;
+                    rotate_right(w);
+                    w = x_parent->right;
+                }
+                w->red = x_parent->red;
+                x_parent->red = false;
+                w->right->red = false;
+                rotate_left(x_parent);
+            } else {
+                node *w = x_parent->left;
+                if (w->red) {
+                    w->red = false;
+                    x_parent->red = true;
+                    rotate_right(x_parent);
+                    w = x_parent->left;
+                }
+                if (!is_red(w->left) && !is_red(w->right)) {
+                    w->red = true;
+                    x = x_parent;
+                    x_parent = x->parent;
+                    continue;
+                }
+                if (!is_red(w->left)) {
+                    w->right->red = false;
+                    w->red = true;
+                    rotate_left(w);
+                    w = x_parent->left;
+                }
+                w->red = x_parent->red;
+                x_parent->red = false;
+                w->left->red = false;
+                rotate_right(x_parent);
+            }
+            x = _dummy->left;
+        }
+        if (x != nullptr) {
+            x->red = false;
+        }
+    }
+
+    static constexpr size_t batch_lanes = 8;
+    static constexpr size_t finger_max_size = size_t{1} << 15;
+
+    template <class K> iterator equal_or_end(node *n, K const &value) const {
+        if (n != _dummy && less(value, n->value)) {
+            return end();
+        }
+        return iterator{n, _dummy};
+    }
+
+    node *const _dummy;
+    Compare _comparator;
+    size_t _node_count{};
+};
+
+// Хеш по умолчанию для hashed: std::hash типа значения стороны.
+struct default_hash {
+    template <class T> size_t operator()(T const &value) const { return std::hash<T>{}(value); }
+};
+
+// Хешированная сторона bimap: передается вместо компаратора,
+// bimap<std::string, int, hashed<>, std::less<int>>. Такая сторона -- хеш-
+// таблица с открытой адресацией (hashed_index): поиск, вставка и удаление
+// за O(1) в среднем, но без порядка, поэтому lower_bound_*, upper_bound_*
+// и политики для нее недоступны, а итерация идет в порядке таблицы.
+template <class Hash = default_hash, class Equal = std::equal_to<>> struct hashed {
+    Hash hash{};
+    Equal equal{};
+};
+
+// Индекс одной стороны bimap по хешу. Интерфейс тот же, что у
+// sorted_tree, насколько он имеет смысл без порядка: locate + insert,
+// find, erase, begin/end, build, swap.
+// Таблица -- линейное пробирование по степени двойки; ячейка хранит хеш
+// значения и узел, так что несовпавшие ключи при поиске сравниваются без
+// обращения к узлам. Удаление оставляет "надгробие", поэтому позиции
+// остальных узлов и итераторы на них не меняются; надгробия убирает
+// перестройка таблицы, которая бывает только при вставке и инвалидирует
+// итераторы этой стороны, как в std::unordered_map.
+template <class T, class tag, class Hash, class Equal, class Allocator>
+struct hashed_index {
+    using type = T;
+    using compare_type = hashed<Hash, Equal>;
+
+    struct node {
+        template <class... Args>
+        explicit node(std::tuple<Args...> args)
+                : value(std::make_from_tuple<T>(std::move(args))) {}
+
+        T value;
+        // Хеш value. У фиктивного узла здесь лежит адрес индекса: по нему
+        // итератор, у которого есть только узел и _end, находит таблицу.
+        size_t hash{};
+    };
+
+    struct iterator {
+        iterator(node *_node, node *end) : _node(_node), _end(end) {}
+
+        [[nodiscard]] bool operator==(iterator const &i) const { return _node == i._node; }
+
+        [[nodiscard]] bool operator!=(iterator const &i) const { return !(*this == i); }
+
+        type const &operator*() const { return _node->value; }
+
+        // Переход к следующему узлу в порядке таблицы.
+        iterator &operator++() {
+            if (_node != _end) {
+                auto const *index = owner();
+                _node = index->occupied_from(index->slot_of(_node) + 1);
+            }
+            return *this;
+        }
+
+        iterator operator++(int) {
+            iterator ret{*this};
+            ++*this;
+            return ret;
+        }
+
+        iterator &operator--() {
+            auto const *index = owner();
+            _node = index->occupied_before(_node == _end ? index->_slots.size()
+                                                         : index->slot_of(_node));
+            return *this;
+        }
+
+        iterator operator--(int) {
+            iterator ret{*this};
+            --*this;
+            return ret;
+        }
+
+        hashed_index const *owner() const {
+            return reinterpret_cast<hashed_index const *>(_end->hash);
+        }
+
+        node *_node;
+        node *_end;
+    };
+
+    hashed_index(node *dummy, compare_type compare, Allocator const &alloc)
+            : _dummy(dummy), _compare(std::move(compare)), _slots(slot_allocator(alloc)) {
+        _dummy->hash = reinterpret_cast<std::uintptr_t>(this);
+    }
+
+    // Место для значения: ячейка найденного узла (found == true, узел в
+    // parent, как у sorted_tree) или ячейка для вставки. Таблица заранее
+    // расширяется под еще один элемент, так что insert по позиции не
+    // аллоцирует и не бросает.
+    struct position {
+        node *parent;
+        size_t slot;
+        size_t hash;
+        bool found;
+    };
+
+    position locate(type const &value) {
+        reserve(_size + 1);
+        size_t const h = _compare.hash(value);
+        size_t free = _slots.size();
+        for (size_t i = home(h);; i = next(i)) {
+            node *n = _slots[i].item;
+            if (n == nullptr) {
+                return {nullptr, free != _slots.size() ? free : i, h, false};
+            }
+            if (n == tombstone()) {
+                free = std::min(free, i);
+            } else if (_slots[i].hash == h && _compare.equal(n->value, value)) {
+                return {n, i, h, true};
+            }
+        }
+    }
+
+    // Кладет n в позицию pos, полученную locate без изменений индекса
+    // после него.
+    iterator insert(position pos, node *n) {
+        if (_slots[pos.slot].item == tombstone()) {
+            --_tombstones;
+        }
+        n->hash = pos.hash;
+        _slots[pos.slot] = {pos.hash, n};
+        ++_size;
+        return iterator{n, _dummy};
+    }
+
+    // Значения n в индексе быть не должно. Вставка сразу после erase
+    // (перестановка узла с новым значением) не расширяет таблицу и не
+    // бросает: место освобождено удалением.
+    iterator insert(node *n) {
+        size_t const h = _compare.hash(n->value);
+        size_t i = home(h);
+        while (_slots[i].item != nullptr && _slots[i].item != tombstone()) {
+            i = next(i);
+        }
+        return insert(position{nullptr, i, h, false}, n);
+    }
+
+    template <class K> iterator find(K const &value) const {
+        return find_hashed(value, _compare.hash(value));
+    }
+
+    template <class K> iterator find_hashed(K const &value, size_t h) const {
+        if (_size == 0) {
+            return end();
+        }
+        for (size_t i = home(h); _slots[i].item != nullptr; i = next(i)) {
+            node *n = _slots[i].item;
+            if (n != tombstone() && _slots[i].hash == h && _compare.equal(n->value, value)) {
+                return iterator{n, _dummy};
+            }
+        }
+        return end();
+    }
+
+    // Пакетный поиск, как у sorted_tree: ключи идут группами, хеши группы
+    // считаются сразу, а их домашние ячейки загружаются заранее.
+    template <class It, class Emit> void find_many(It first, It last, Emit emit) const {
+        constexpr size_t lanes_max = 8;
+        while (first != last) {
+            using key_ptr = decltype(std::addressof(*first));
+            key_ptr keys[lanes_max];
+            size_t hashes[lanes_max];
+            size_t lanes = 0;
+            for (; lanes < lanes_max && first != last; ++lanes, ++first) {
+                keys[lanes] = std::addressof(*first);
+                hashes[lanes] = _compare.hash(*first);
+                if (_size != 0) {
+                    __builtin_prefetch(&_slots[home(hashes[lanes])]);
+                }
+            }
+            for (size_t i = 0; i < lanes; ++i) {
+                emit(find_hashed(*keys[i], hashes[i]));
+            }
+        }
+    }
+
+    // Как у sorted_tree: место и хеш value находятся до изменений, при
+    // исключении из присваивания n возвращается в свою ячейку.
+    void relink(node *n, type &&value) {
+        position pos = locate(value);
+        size_t const old_slot = slot_of(n);
+        size_t const old_hash = n->hash;
+        erase(n);
+        try {
+            n->value = std::move(value);
+        } catch (...) {
+            insert(position{nullptr, old_slot, old_hash, false}, n);
+            throw;
+        }
+        insert(pos, n);
+    }
+
+    iterator erase(node *n) {
+        size_t i = slot_of(n);
+        _slots[i].item = tombstone();
+        ++_tombstones;
+        --_size;
+        return iterator{occupied_from(i + 1), _dummy};
+    }
+
+    iterator begin() const { return iterator{occupied_from(0), _dummy}; }
+
+    iterator end() const { return iterator{_dummy, _dummy}; }
+
+    compare_type const &comparator() const { return _compare; }
+    compare_type &comparator() { return _compare; }
+
+    size_t size() const { return _size; }
+
+    // Память таблицы (узлы выделяет bimap).
+    size_t memory_usage() const { return _slots.capacity() * sizeof(slot); }
+
+    // Заполняет пустой индекс узлами [first, last) с различными
+    // значениями, равенство не проверяется.
+    template <class It> void build(It first, It last) {
+        reserve(static_cast<size_t>(last - first));
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    // Готовит таблицу к count элементам: занятых ячеек (с надгробиями)
+    // должно быть не больше 3/4. Если места нет,
+    // таблица перестраивается: вдвое больше, если живых элементов больше
+    // половины, иначе того же размера, только без надгробий.
+    void reserve(size_t count) {
+        if ((count + _tombstones) * 4 <= _slots.size() * 3) {
+            return;
+        }
+        unsigned bits = std::max(_bits, 4u);
+        while (count * 2 > (size_t{1} << bits)) {
+            ++bits;
+        }
+        std::vector<slot, slot_allocator> fresh(size_t{1} << bits, slot{0, nullptr},
+                                                _slots.get_allocator());
+        std::swap(_bits, bits);
+        for (auto const &s : _slots) {
+            if (s.item != nullptr && s.item != tombstone()) {
+                size_t i = home(s.hash);
+                while (fresh[i].item != nullptr) {
+                    i = (i + 1) & (fresh.size() - 1);
+                }
+                fresh[i] = s;
+            }
+        }
+        _slots.swap(fresh);
+        _tombstones = 0;
+    }
+
+    // Вызывает f для каждого узла индекса.
+    template <class F> void for_each(F f) const {
+        for (auto const &s : _slots) {
+            if (s.item != nullptr && s.item != tombstone()) {
+                f(s.item);
+            }
+        }
+    }
+
+    // Забывает все узлы, таблица сохраняет размер.
+    void clear() noexcept {
+        std::fill(_slots.begin(), _slots.end(), slot{0, nullptr});
+        _size = 0;
+        _tombstones = 0;
+    }
+
+    // Адреса индексов в фиктивных узлах не меняются: индексы остаются
+    // на месте, меняется только содержимое таблиц. Итераторы этой стороны
+    // обмен инвалидирует.
+    void swap(hashed_index &other) noexcept(std::is_nothrow_swappable_v<compare_type>) {
+        using std::swap;
+        swap(_compare, other._compare);
+        _slots.swap(other._slots);
+        std::swap(_size, other._size);
+        std::swap(_tombstones, other._tombstones);
+        std::swap(_bits, other._bits);
+    }
+
+private:
+    struct slot {
+        size_t hash;
+        node *item;
+    };
+
+    using slot_allocator =
+            typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+
+    // Метка удаленной ячейки, общая для всех индексов типа.
+    static node *tombstone() {
+        static char marker;
+        return reinterpret_cast<node *>(&marker);
+    }
+
+    // Домашняя ячейка: старшие биты произведения на 2^64 / phi, чтобы
+    // тождественный std::hash целых не давал кластеров на ключах с общим
+    // шагом.
+    size_t home(size_t h) const {
+        return static_cast<size_t>((static_cast<std::uint64_t>(h) * 0x9E3779B97F4A7C15ull) >>
+                                   (64 - _bits));
+    }
+
+    size_t next(size_t i) const { return (i + 1) & (_slots.size() - 1); }
+
+    size_t slot_of(node const *n) const {
+        size_t i = home(n->hash);
+        while (_slots[i].item != n) {
+            i = next(i);
+        }
+        return i;
+    }
+
+    node *occupied_from(size_t i) const {
+        for (; i < _slots.size(); ++i) {
+            if (_slots[i].item != nullptr && _slots[i].item != tombstone()) {
+                return _slots[i].item;
+            }
+        }
+        return _dummy;
+    }
+
+    // Последний занятый узел в ячейках [0, i). Декремент begin() неопределен.
+    node *occupied_before(size_t i) const {
+        while (_slots[--i].item == nullptr || _slots[i].item == tombstone()) {
+        }
+        return _slots[i].item;
+    }
+
+    node *const _dummy;
+    compare_type _compare;
+    std::vector<slot, slot_allocator> _slots;
+    size_t _size{};
+    size_t _tombstones{};
+    unsigned _bits{};
+};
+
+// Индекс стороны bimap: hashed_index для компаратора hashed<...>, иначе
+// sorted_tree.
+template <class T, class tag, class Compare, class Allocator, class... Policies>
+struct side_index {
+    using type = sorted_tree<T, tag, Compare, Policies...>;
+};
+
+template <class T, class tag, class Hash, class Equal, class Allocator, class... Policies>
+struct side_index<T, tag, hashed<Hash, Equal>, Allocator, Policies...> {
+    using type = hashed_index<T, tag, Hash, Equal, Allocator>;
+};
+
+template <class Index> inline constexpr bool is_hashed_index_v = false;
+
+template <class T, class tag, class Hash, class Equal, class Allocator>
+inline constexpr bool is_hashed_index_v<hashed_index<T, tag, Hash, Equal, Allocator>> = true;
+
+// Метка для массовой вставки диапазона, уже упорядоченного по left.
+struct sorted_left_t {
+    explicit sorted_left_t() = default;
+};
+inline constexpr sorted_left_t sorted_left{};
+
+// Метка параллельного пакетного поиска (find_left_many и др.).
+struct parallel_t {
+    explicit parallel_t() = default;
+};
+inline constexpr parallel_t parallel{};
+
+// Разница двух bimap по left (см. diff): пары, которых не было, пары,
+// которых не стало, и left, чей right сменился. Все списки упорядочены по
+// left.
+template <class Left, class Right> struct bimap_delta {
+    struct remap {
+        Left left;
+        Right from;
+        Right to;
+    };
+
+    bool empty() const { return added.empty() && removed.empty() && remapped.empty(); }
+
+    std::vector<std::pair<Left, Right>> added;
+    std::vector<std::pair<Left, Right>> removed;
+    std::vector<remap> remapped;
+};
+
+// Снимок счетчиков bimap (политика instrumented). Для хешированной
+// стороны счетчики дерева нулевые.
+struct bimap_statistics {
+    tree_statistics left;
+    tree_statistics right;
+    // Обращения пула узлов к аллокатору (блоки узлов и заголовок арены)
+    // и выделенные ими байты.
+    std::uint64_t allocations{};
+    std::uint64_t allocated_bytes{};
+};
+
+// Счетчики аллокаций пула узлов bimap, устроены как tree_counters.
+template <bool Measured> struct pool_counters {
+    void note_allocation(size_t) const {}
+};
+
+template <> struct pool_counters<true> {
+    void note_allocation(size_t bytes) const {
+        _allocations.add(1);
+        _allocated_bytes.add(bytes);
+    }
+
+    void read(bimap_statistics &result) const {
+        result.allocations = _allocations.get();
+        result.allocated_bytes = _allocated_bytes.get();
+    }
+
+    void reset_statistics() {
+        _allocations.reset();
+        _allocated_bytes.reset();
+    }
+
+private:
+    stat_counter _allocations;
+    stat_counter _allocated_bytes;
+};
+
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+        typename CompareRight = std::less<Right>,
+        typename Allocator = std::allocator<std::pair<Left, Right>>,
+        typename... Policies>
+struct bimap {
+    struct left_tag;
+    struct right_tag;
+
+    using left_tree =
+            typename side_index<Left, left_tag, CompareLeft, Allocator, Policies...>::type;
+    using right_tree =
+            typename side_index<Right, right_tag, CompareRight, Allocator, Policies...>::type;
+
+    // Хотя бы одна сторона -- хеш-таблица: операции, которые
+    // перестраивают деревья по порядку сторон, идут поштучно.
+    static constexpr bool left_hashed = is_hashed_index_v<left_tree>;
+    static constexpr bool right_hashed = is_hashed_index_v<right_tree>;
+    static constexpr bool any_hashed = left_hashed || right_hashed;
+    static constexpr bool measured = has_policy_v<instrumented, Policies...>;
+
+    using left_t = Left;
+    using right_t = Right;
 
     struct node : left_tree::node, right_tree::node {
         template <class L, class R>
-        node(L &&l_val, R &&r_val, node *const dummy)
-                : left_tree::node{std::forward<L>(l_val), dummy, dummy, dummy},
-                  right_tree::node{std::forward<R>(r_val), dummy, dummy, dummy} {}
+        node(L &&l_val, R &&r_val)
+                : left_tree::node(std::forward_as_tuple(std::forward<L>(l_val))),
+                  right_tree::node(std::forward_as_tuple(std::forward<R>(r_val))) {}
+
+        template <class... LeftArgs, class... RightArgs>
+        node(std::piecewise_construct_t, std::tuple<LeftArgs...> &l_args,
+             std::tuple<RightArgs...> &r_args)
+                : left_tree::node(std::move(l_args)),
+                  right_tree::node(std::move(r_args)) {}
 
         typename left_tree::node &left() {
             return static_cast<typename left_tree::node &>(*this);
@@ -361,6 +1633,10 @@ struct bimap {
 
     using node_t = node;
 
+    using allocator_type = Allocator;
+    using node_allocator =
+            typename std::allocator_traits<Allocator>::template rebind_alloc<node_t>;
+
     struct right_iterator;
     struct left_iterator;
 
@@ -480,166 +1756,593 @@ struct bimap {
         typename left_tree::iterator _iterator;
     };
 
+private:
+    struct node_pool;
+
+public:
+    // Пара, извлеченная из bimap вместе с узлом (см. std::map::node_type).
+    // Держит память узла, поэтому может пережить bimap и быть вставлена в
+    // любой bimap с равным аллокатором без копирования значений.
+    // Пока пара в node_handle, ее left и right можно менять.
+    struct node_handle {
+        node_handle() = default;
+
+        node_handle(node_handle &&other) noexcept
+                : _node(std::exchange(other._node, nullptr)),
+                  _arena(std::exchange(other._arena, nullptr)) {}
+
+        node_handle &operator=(node_handle &&other) noexcept {
+            node_handle(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        ~node_handle() {
+            if (_node != nullptr) {
+                node_pool::dispose(_node, _arena);
+            }
+        }
+
+        [[nodiscard]] bool empty() const noexcept { return _node == nullptr; }
+        explicit operator bool() const noexcept { return !empty(); }
+
+        // Доступ к значениям пустого node_handle неопределен.
+        left_t &left() const { return _node->left().value; }
+        right_t &right() const { return _node->right().value; }
+
+        allocator_type get_allocator() const {
+            return allocator_type(_arena->alloc);
+        }
+
+        void swap(node_handle &other) noexcept {
+            std::swap(_node, other._node);
+            std::swap(_arena, other._arena);
+        }
+
+        friend void swap(node_handle &a, node_handle &b) noexcept { a.swap(b); }
+
+    private:
+        friend struct bimap;
+
+        node_handle(node_t *node, typename node_pool::arena *arena)
+                : _node(node), _arena(arena) {}
+
+        node_t *_node{};
+        typename node_pool::arena *_arena{};
+    };
+
+    // Результат insert(node_handle &&). При неудаче node возвращает пару
+    // обратно, а position указывает на пару, с которой она конфликтует.
+    struct insert_return_type {
+        left_iterator position;
+        bool inserted;
+        node_handle node;
+    };
+
     // Создает bimap не содержащий ни одной пары.
     bimap(CompareLeft compare_left = CompareLeft(),
-          CompareRight compare_right = CompareRight())
-            : _left_tree(_dummy, compare_left), _right_tree(_dummy, compare_right) {
-        _dummy->left().parent = _dummy;
-        _dummy->left().left = _dummy;
-        _dummy->left().right = _dummy;
+          CompareRight compare_right = CompareRight(),
+          Allocator const &alloc = Allocator())
+            : _left_tree(_dummy, compare_left, alloc),
+              _right_tree(_dummy, compare_right, alloc), _pool(node_allocator(alloc)) {}
+
+    explicit bimap(Allocator const &alloc)
+            : bimap(CompareLeft(), CompareRight(), alloc) {}
+
+    // Создает bimap из диапазона пар (элементы разбираются через std::get<0> и
+    // std::get<1>), см. insert_range.
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    bimap(InputIt first, InputIt last, CompareLeft compare_left = CompareLeft(),
+          CompareRight compare_right = CompareRight(),
+          Allocator const &alloc = Allocator())
+            : bimap(compare_left, compare_right, alloc) {
+        insert_range(first, last);
+    }
 
-        _dummy->right().parent = _dummy;
-        _dummy->right().left = _dummy;
-        _dummy->right().right = _dummy;
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    bimap(sorted_left_t, InputIt first, InputIt last,
+          CompareLeft compare_left = CompareLeft(),
+          CompareRight compare_right = CompareRight(),
+          Allocator const &alloc = Allocator())
+            : bimap(compare_left, compare_right, alloc) {
+        insert_range(sorted_left, first, last);
     }
 
     // Конструкторы от других и присваивания
+    // Копирование линейно: пары копируются в порядке обхода other, и оба
+    // дерева строятся сбалансированными без вызовов компараторов.
     bimap(bimap const &other)
-            : bimap(other._left_tree.comparator(), other._right_tree.comparator()) {
-        for (auto it = other.begin_left(); it != other.end_left(); ++it) {
-            auto *n = static_cast<node_t *>(it.node());
-            insert(n->left().value, n->right().value);
-        }
+            : bimap(other, std::allocator_traits<Allocator>::
+                                   select_on_container_copy_construction(
+                                           other.get_allocator())) {}
+
+    bimap(bimap const &other, Allocator const &alloc)
+            : bimap(other._left_tree.comparator(), other._right_tree.comparator(),
+                    alloc) {
+        copy_nodes(other);
+    }
+
+    // Перемещение за O(1): узлы не трогаются, к фиктивному узлу нового
+    // владельца перевешиваются только корни деревьев. other остается пустым.
+    bimap(bimap &&other) noexcept(std::is_nothrow_copy_constructible_v<CompareLeft> &&
+                                  std::is_nothrow_copy_constructible_v<CompareRight>)
+            : bimap(other._left_tree.comparator(), other._right_tree.comparator(),
+                    other.get_allocator()) {
+        swap(other);
     }
 
+    // Строгая гарантия: если копирование бросит исключение, *this не
+    // изменится.
     bimap &operator=(bimap const &other) {
-        _left_tree.comparator() = other._left_tree.comparator();
-        _right_tree.comparator() = other._right_tree.comparator();
-        for (auto it = other.begin_left(); it != other.end_left(); ++it) {
-            auto *n = static_cast<node_t *>(it.node());
-            insert(n->left().value, n->right().value);
+        if (this != &other) {
+            bimap copy(other,
+                       std::allocator_traits<Allocator>::
+                                       propagate_on_container_copy_assignment::value
+                               ? other.get_allocator()
+                               : get_allocator());
+            swap(copy);
         }
         return *this;
     }
 
+    // Если аллокатор не переносится и аллокаторы различны, узлы other не
+    // могут перейти к *this, и пары копируются.
+    bimap &operator=(bimap &&other) noexcept(
+            (std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value ||
+             std::allocator_traits<Allocator>::is_always_equal::value) &&
+            std::is_nothrow_copy_constructible_v<CompareLeft> &&
+            std::is_nothrow_copy_constructible_v<CompareRight>) {
+        if (this == &other) {
+            return *this;
+        }
+        if constexpr (!std::allocator_traits<
+                              Allocator>::propagate_on_container_move_assignment::value) {
+            if (get_allocator() != other.get_allocator()) {
+                return *this = static_cast<bimap const &>(other);
+            }
+        }
+        bimap moved(std::move(other));
+        swap(moved);
+        return *this;
+    }
+
     // Деструктор. Вызывается при удалении объектов bimap.
     // Инвалидирует все итераторы ссылающиеся на элементы этого bimap
     // (включая итераторы ссылающиеся на элементы следующие за последними).
-    ~bimap() { delete_tree(static_cast<node_t *>(_dummy->left().left)); }
+    ~bimap() {
+        if constexpr (!std::is_trivially_destructible_v<node_t>) {
+            dismantle([this](node_t *n) { _pool.destroy_value(n); });
+        }
+    }
+
+    // Удаляет все пары за O(n) без рекурсии. Узлы остаются в пуле и
+    // переиспользуются следующими вставками, память не освобождается.
+    // Свободные узлы выдаются по возрастанию адреса, как из нового блока:
+    // иначе узлы, вставленные подряд, лежат в памяти вразброс, в порядке
+    // ключей прошлого содержимого. Если на сортировку не хватило памяти,
+    // узлы просто возвращаются в пул.
+    // Инвалидирует все итераторы, кроме end_left() и end_right().
+    void clear() noexcept {
+        std::vector<node_t *> freed;
+        try {
+            freed.reserve(size());
+        } catch (...) {
+        }
+        dismantle([&](node_t *n) {
+            if (freed.size() < freed.capacity()) {
+                _pool.destroy_value(n);
+                freed.push_back(n);
+            } else {
+                _pool.destroy(n);
+            }
+        });
+        std::sort(freed.begin(), freed.end(), std::greater<>());
+        for (node_t *n : freed) {
+            _pool.recycle(n);
+        }
+        _left_tree.clear();
+        _right_tree.clear();
+    }
+
+    // Обменивается содержимым с other за O(1). Итераторы на элементы остаются
+    // валидными и ссылаются теперь на элементы другого bimap; итераторы
+    // хешированной стороны обмен инвалидирует.
+    void swap(bimap &other) noexcept(std::is_nothrow_swappable_v<CompareLeft> &&
+                                     std::is_nothrow_swappable_v<CompareRight>) {
+        _left_tree.swap(other._left_tree);
+        _right_tree.swap(other._right_tree);
+        _pool.swap(other._pool);
+    }
+
+    friend void swap(bimap &a, bimap &b) noexcept(noexcept(a.swap(b))) {
+        a.swap(b);
+    }
 
     // Вставка пары (left, right), возвращает итератор на left.
     // Если такой left или такой right уже присутствуют в bimap, вставка не
     // производится и возвращается end_left().
+    // Каждое дерево спускается один раз: найденное при проверке на дубликат
+    // место сразу используется для вставки. Неудачная вставка ничего не
+    // аллоцирует, кроме расширения таблицы хешированной стороны; расширение
+    // инвалидирует итераторы этой стороны.
     left_iterator insert(left_t const &left, right_t const &right) {
-        if (find_left(left) != end_left() || find_right(right) != end_right()) {
-            return end_left();
-        }
-        std::unique_ptr<node_t> node = create_node(left, right);
-        _right_tree.insert(node.get());
-        return _left_tree.insert(node.release());
+        return insert_pair(left, right);
     }
 
     left_iterator insert(left_t const &left, right_t &&right) {
-        if (find_left(left) != end_left() || find_right(right) != end_right()) {
-            return end_left();
-        }
-        std::unique_ptr<node_t> node = create_node(left, std::move(right));
-        _right_tree.insert(node.get());
-        return _left_tree.insert(node.release());
+        return insert_pair(left, std::move(right));
     }
 
     left_iterator insert(left_t &&left, right_t const &right) {
-        if (find_left(left) != end_left() || find_right(right) != end_right()) {
-            return end_left();
-        }
-        std::unique_ptr<node_t> node = create_node(std::move(left), right);
-        _right_tree.insert(node.get());
-        return _left_tree.insert(node.release());
+        return insert_pair(std::move(left), right);
     }
 
     left_iterator insert(left_t &&left, right_t &&right) {
-        if (find_left(left) != end_left() || find_right(right) != end_right()) {
-            return end_left();
-        }
-        std::unique_ptr<node_t> node =
-                create_node(std::move(left), std::move(right));
-        _right_tree.insert(node.get());
-        return _left_tree.insert(node.release());
+        return insert_pair(std::move(left), std::move(right));
     }
 
-    // Удаляет элемент и соответствующий ему парный.
-    // erase невалидного итератора неопределен.
-    // erase(end_left()) и erase(end_right()) неопределены.
-    // Пусть it ссылается на некоторый элемент e.
-    // erase инвалидирует все итераторы ссылающиеся на e и на элемент парный к e.
+    // Создает пару прямо в узле: left из аргументов left_args, right из
+    // right_args. Так как значения нужны для поиска, узел создается до
+    // проверки на дубликат; при неудаче он возвращается в пул.
+    template <class... LeftArgs, class... RightArgs>
+    left_iterator emplace_left_right(std::piecewise_construct_t,
+                                     std::tuple<LeftArgs...> left_args,
+                                     std::tuple<RightArgs...> right_args) {
+        return link_node(
+                _pool.create(std::piecewise_construct, left_args, right_args));
+    }
+
+    template <class L, class R> left_iterator emplace_left_right(L &&left, R &&right) {
+        return emplace_left_right(std::piecewise_construct,
+                                  std::forward_as_tuple(std::forward<L>(left)),
+                                  std::forward_as_tuple(std::forward<R>(right)));
+    }
+
+    // Массовая вставка диапазона пар. Результат тот же, что у insert по
+    // одной паре в порядке диапазона: пара пропускается, если ее left или
+    // right уже есть в bimap или в одной из ранее вставленных пар диапазона.
+    // Диапазон сортируется по каждой стороне, дубликаты отбрасываются одним
+    // линейным проходом, и оба дерева перестраиваются сбалансированными за
+    // O(n + k) после сортировки. Маленький по сравнению с bimap диапазон
+    // вставляется поэлементно. Строгая гарантия: если бросит исключение,
+    // bimap не меняется (поэлементно вставленные пары вынимаются обратно).
+    template <class InputIt> void insert_range(InputIt first, InputIt last) {
+        bulk_insert(first, last, false);
+    }
+
+    // То же для диапазона, упорядоченного по left: сортировка по left
+    // пропускается. Неупорядоченный диапазон -- неопределенное поведение.
+    template <class InputIt>
+    void insert_range(sorted_left_t, InputIt first, InputIt last) {
+        bulk_insert(first, last, true);
+    }
+
+    // Заменяет содержимое парами диапазона, строгая гарантия.
+    template <class InputIt> void assign(InputIt first, InputIt last) {
+        bimap other(first, last, _left_tree.comparator(), _right_tree.comparator(),
+                    get_allocator());
+        swap(other);
+    }
+
+    template <class InputIt>
+    void assign(sorted_left_t, InputIt first, InputIt last) {
+        bimap other(sorted_left, first, last, _left_tree.comparator(),
+                    _right_tree.comparator(), get_allocator());
+        swap(other);
+    }
+
+    // Удаляет элемент и соответствующий ему парный.
+    // erase невалидного итератора неопределен.
+    // erase(end_left()) и erase(end_right()) неопределены.
+    // Пусть it ссылается на некоторый элемент e.
+    // erase инвалидирует все итераторы ссылающиеся на e и на элемент парный к e.
     left_iterator erase_left(left_iterator it) {
         auto n = static_cast<node_t *>(it._iterator._node);
         auto ret_it = _left_tree.erase(n);
         _right_tree.erase(n);
-        delete_tree(n);
+        _pool.destroy(n);
         return ret_it;
     }
     // Аналогично erase, но по ключу, удаляет элемент если он присутствует, иначе
     // не делает ничего Возвращает была ли пара удалена
-    bool erase_left(left_t const &left) {
-        auto founded = _left_tree.find(left);
-        _left_tree.erase(founded._node);
-        _right_tree.erase(static_cast<node_t *>(founded._node));
-        return founded._node != _dummy;
+    bool erase_left(left_t const &left) { return erase_key(_left_tree, left); }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    bool erase_left(K const &left) {
+        return erase_key(_left_tree, left);
     }
 
     right_iterator erase_right(right_iterator it) {
         auto n = static_cast<node_t *>(it._iterator._node);
         auto ret_it = _right_tree.erase(n);
         _left_tree.erase(n);
-        delete_tree(n);
+        _pool.destroy(n);
         return ret_it;
     }
 
-    bool erase_right(right_t const &right) {
-        auto founded = _right_tree.find(right);
-        if (founded._node != _dummy) {
-            _right_tree.erase(founded._node);
-            _left_tree.erase(static_cast<node_t *>(founded._node));
-        }
-        return founded._node != _dummy;
+    bool erase_right(right_t const &right) { return erase_key(_right_tree, right); }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    bool erase_right(K const &right) {
+        return erase_key(_right_tree, right);
     }
 
     // erase от ренжа, удаляет [first, last), возвращает итератор на последний
     // элемент за удаленной последовательностью
+    // Диапазон вырезается из своего дерева за O(log n) амортизированно, из
+    // противоположного дерева его k узлов удаляются поштучно, если их мало,
+    // иначе оно перестраивается за O(n). Узлы возвращаются в пул одним
+    // проходом.
     left_iterator erase_left(left_iterator first, left_iterator last) {
-        while (first != last) {
-            first = erase_left(first);
-        }
-        return first;
+        erase_range(_left_tree, _right_tree, first._iterator, last._iterator);
+        return last;
     }
 
     right_iterator erase_right(right_iterator first, right_iterator last) {
-        while (first != last) {
-            first = erase_right(first);
+        erase_range(_right_tree, _left_tree, first._iterator, last._iterator);
+        return last;
+    }
+
+    // Извлекает пару из bimap, не разрушая ее узел. Итераторы на
+    // извлеченную пару инвалидируются. extract_*(end_*()) неопределен,
+    // извлечение по отсутствующему ключу возвращает пустой node_handle.
+    node_handle extract_left(left_iterator it) {
+        return extract(static_cast<node_t *>(it._iterator._node));
+    }
+
+    node_handle extract_left(left_t const &left) { return extract_key(_left_tree, left); }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    node_handle extract_left(K const &left) {
+        return extract_key(_left_tree, left);
+    }
+
+    node_handle extract_right(right_iterator it) {
+        return extract(static_cast<node_t *>(it._iterator._node));
+    }
+
+    node_handle extract_right(right_t const &right) {
+        return extract_key(_right_tree, right);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    node_handle extract_right(K const &right) {
+        return extract_key(_right_tree, right);
+    }
+
+    // Вставляет пару из node_handle, перевешивая его узел. Узел из чужого
+    // пула удерживает свою арену, пока жив *this (см. node_pool), а первый
+    // узел из каждой новой арены может аллоцировать запись в индексе пула.
+    // Если аллокаторы не равны, значения перемещаются в узел своего пула.
+    // Если вставка бросит исключение, пара остается в node_handle.
+    insert_return_type insert(node_handle &&handle) {
+        if (handle.empty()) {
+            return {end_left(), false, node_handle()};
+        }
+        node_t *node = handle._node;
+        auto left_pos = _left_tree.locate(node->left().value);
+        if (left_pos.found) {
+            return {typename left_tree::iterator{left_pos.parent, _dummy}, false,
+                    std::move(handle)};
+        }
+        auto right_pos = _right_tree.locate(node->right().value);
+        if (right_pos.found) {
+            return {flip_to_left(typename right_tree::iterator{right_pos.parent, _dummy}),
+                    false, std::move(handle)};
+        }
+        if (_pool.compatible(handle._arena->alloc)) {
+            _pool.cover(node, handle._arena);
+            node_pool::release(std::exchange(handle._arena, nullptr));
+        } else {
+            node = _pool.relocate(node);
+            node_pool::dispose(handle._node, std::exchange(handle._arena, nullptr));
+        }
+        handle._node = nullptr;
+        _right_tree.insert(right_pos, node);
+        return {_left_tree.insert(left_pos, node), true, node_handle()};
+    }
+
+    // Переносит из source все пары, ни left, ни right которых нет в *this,
+    // перевешивая их узлы; остальные пары остаются в source. *this
+    // принимает арены перенесенных узлов, как insert(node_handle &&). При
+    // неравных аллокаторах значения перемещаются в узлы пула *this, а
+    // узлы source возвращаются в его пул. Пары source перебираются по
+    // возрастанию left, поэтому поиск в левом дереве *this идет рядом с
+    // корнем, оставшимся от предыдущей вставки. Если компаратор или перенос
+    // бросит исключение, уже перенесенные пары остаются в *this.
+    void merge(bimap &source) {
+        if (this == &source || source.empty()) {
+            return;
+        }
+        bool const relink = _pool.compatible(source._pool.get_allocator());
+        for (auto it = source.begin_left(); it != source.end_left();) {
+            auto *n = static_cast<node_t *>(it.node());
+            ++it;
+            auto left_pos = _left_tree.locate(n->left().value);
+            if (left_pos.found) {
+                continue;
+            }
+            auto right_pos = _right_tree.locate(n->right().value);
+            if (right_pos.found) {
+                continue;
+            }
+            node_t *moved = n;
+            if (relink) {
+                auto *from = source._pool.arena_of(n);
+                _pool.cover(n, from);
+                source._pool.forget(from);
+            } else {
+                moved = _pool.relocate(n);
+            }
+            source._left_tree.erase(n);
+            source._right_tree.erase(n);
+            if (!relink) {
+                source._pool.destroy(n);
+            }
+            _right_tree.insert(right_pos, moved);
+            _left_tree.insert(left_pos, moved);
         }
-        return first;
     }
 
+    void merge(bimap &&source) { merge(source); }
+
     // Возвращает итератор по элементу. Если не найден - соответствующий end()
+    // Перегрузки с шаблонным K доступны для прозрачных компараторов
+    // (например, std::less<>) и ищут по любому сравнимому ключу, не создавая
+    // временный left_t/right_t.
+    // С политикой splay_on_read неконстантные перегрузки find_* и at_*
+    // перестраивают дерево своей стороны; итераторы остаются валидными.
     left_iterator find_left(left_t const &left) const {
         return _left_tree.find(left);
     }
 
+    left_iterator find_left(left_t const &left) { return _left_tree.find(left); }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator find_left(K const &left) const {
+        return _left_tree.find(left);
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator find_left(K const &left) {
+        return _left_tree.find(left);
+    }
+
     right_iterator find_right(right_t const &right) const {
         return _right_tree.find(right);
     }
 
+    right_iterator find_right(right_t const &right) { return _right_tree.find(right); }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator find_right(K const &right) const {
+        return _right_tree.find(right);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator find_right(K const &right) {
+        return _right_tree.find(right);
+    }
+
+    // Пакетный поиск: для каждого ключа [first, last) по порядку в out
+    // пишется результат find_*, возвращается out за последним записанным.
+    // Пакет, упорядоченный компаратором стороны, ищется от предыдущего
+    // найденного ключа, O(k log(n / k)) в сбалансированном дереве;
+    // остальные -- несколькими спусками вперемешку с предзагрузкой узлов.
+    // Дерево не меняется и при splay_on_read.
+    template <class ForwardIt, class OutputIt>
+    OutputIt find_left_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        _left_tree.find_many(first, last, [&](typename left_tree::iterator it) {
+            *out++ = left_iterator(it);
+        });
+        return out;
+    }
+
+    template <class ForwardIt, class OutputIt>
+    OutputIt find_right_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        _right_tree.find_many(first, last, [&](typename right_tree::iterator it) {
+            *out++ = right_iterator(it);
+        });
+        return out;
+    }
+
+    // Пакетный at_*: в out пишутся парные значения. Отсутствующий ключ --
+    // std::out_of_range, значения для ключей перед ним уже записаны.
+    template <class ForwardIt, class OutputIt>
+    OutputIt at_left_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        _left_tree.find_many(first, last, [&](typename left_tree::iterator it) {
+            if (it == _left_tree.end()) {
+                throw std::out_of_range{"at_left_many: not found"};
+            }
+            *out++ = static_cast<node_t *>(it._node)->right().value;
+        });
+        return out;
+    }
+
+    template <class ForwardIt, class OutputIt>
+    OutputIt at_right_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+        _right_tree.find_many(first, last, [&](typename right_tree::iterator it) {
+            if (it == _right_tree.end()) {
+                throw std::out_of_range{"at_right_many: not found"};
+            }
+            *out++ = static_cast<node_t *>(it._node)->left().value;
+        });
+        return out;
+    }
+
+    // То же с разбиением большого пакета на части по аппаратным потокам.
+    // bimap во время поиска не должен меняться. out -- произвольного
+    // доступа, места под результаты выделены заранее. Исключение из любой
+    // части пробрасывается после завершения всех частей.
+    template <class RandomIt, class RandomOutIt>
+    RandomOutIt find_left_many(parallel_t, RandomIt first, RandomIt last,
+                               RandomOutIt out) const {
+        return parallel_many(first, last, out, [this](RandomIt f, RandomIt l, RandomOutIt o) {
+            return find_left_many(f, l, o);
+        });
+    }
+
+    template <class RandomIt, class RandomOutIt>
+    RandomOutIt find_right_many(parallel_t, RandomIt first, RandomIt last,
+                                RandomOutIt out) const {
+        return parallel_many(first, last, out, [this](RandomIt f, RandomIt l, RandomOutIt o) {
+            return find_right_many(f, l, o);
+        });
+    }
+
+    template <class RandomIt, class RandomOutIt>
+    RandomOutIt at_left_many(parallel_t, RandomIt first, RandomIt last,
+                             RandomOutIt out) const {
+        return parallel_many(first, last, out, [this](RandomIt f, RandomIt l, RandomOutIt o) {
+            return at_left_many(f, l, o);
+        });
+    }
+
+    template <class RandomIt, class RandomOutIt>
+    RandomOutIt at_right_many(parallel_t, RandomIt first, RandomIt last,
+                              RandomOutIt out) const {
+        return parallel_many(first, last, out, [this](RandomIt f, RandomIt l, RandomOutIt o) {
+            return at_right_many(f, l, o);
+        });
+    }
+
     // Возвращает противоположный элемент по элементу
     // Если элемента не существует -- бросает std::out_of_range
     right_t const &at_left(left_t const &key) const {
-        auto l_node = find_left(key)._iterator._node;
-        if (l_node == _dummy) {
-            throw std::out_of_range{"at_left: not found"};
-        }
-        return static_cast<typename right_tree::node *>(
-                static_cast<node_t *>(l_node))
-                ->value;
+        return at_key(_left_tree, key, "at_left: not found")->right().value;
+    }
+
+    right_t const &at_left(left_t const &key) {
+        return at_key(_left_tree, key, "at_left: not found")->right().value;
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    right_t const &at_left(K const &key) const {
+        return at_key(_left_tree, key, "at_left: not found")->right().value;
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    right_t const &at_left(K const &key) {
+        return at_key(_left_tree, key, "at_left: not found")->right().value;
     }
 
     left_t const &at_right(right_t const &key) const {
-        auto r_node = find_right(key)._iterator._node;
-        if (r_node == _dummy) {
-            throw std::out_of_range{"at_right: not found"};
-        }
-        return static_cast<typename left_tree::node *>(
-                static_cast<node_t *>(r_node))
-                ->value;
+        return at_key(_right_tree, key, "at_right: not found")->left().value;
+    }
+
+    left_t const &at_right(right_t const &key) {
+        return at_key(_right_tree, key, "at_right: not found")->left().value;
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    left_t const &at_right(K const &key) const {
+        return at_key(_right_tree, key, "at_right: not found")->left().value;
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    left_t const &at_right(K const &key) {
+        return at_key(_right_tree, key, "at_right: not found")->left().value;
     }
 
     // Возвращает противоположный элемент по элементу
@@ -648,35 +2351,39 @@ struct bimap {
     // Если дефолтный элемент уже лежит в противоположной паре - должен поменять
     // соответствующий ему элемент на запрашиваемый (смотри тесты)
     right_t const &at_left_or_default(left_t const &key) {
-        auto l_node = find_left(key)._iterator._node;
-        if (l_node == _dummy) {
-            auto r_node = find_right({})._iterator._node;
-            if (r_node == _dummy) {
-                l_node = insert(key, {})._iterator._node;
-            } else {
-                l_node = static_cast<node_t *>(r_node);
-                l_node->value = key;
-            }
+        auto left_pos = _left_tree.locate(key);
+        if (left_pos.found) {
+            return static_cast<node_t *>(left_pos.parent)->right().value;
+        }
+        right_t value{};
+        auto right_pos = _right_tree.locate(value);
+        if (!right_pos.found) {
+            node_t *node = create_node(key, std::move(value));
+            _right_tree.insert(right_pos, node);
+            _left_tree.insert(left_pos, node);
+            return node->right().value;
         }
-        return static_cast<typename right_tree::node *>(
-                static_cast<node_t *>(l_node))
-                ->value;
+        auto *node = static_cast<node_t *>(right_pos.parent);
+        relink_value(_left_tree, node->left(), key);
+        return node->right().value;
     }
 
     left_t const &at_right_or_default(right_t const &key) {
-        auto r_node = find_right(key)._iterator._node;
-        if (r_node == _dummy) {
-            auto l_node = find_left({})._iterator._node;
-            if (l_node == _dummy) {
-                r_node = static_cast<node_t *>(insert({}, key)._iterator._node);
-            } else {
-                r_node = static_cast<node_t *>(l_node);
-                r_node->value = key;
-            }
+        auto right_pos = _right_tree.locate(key);
+        if (right_pos.found) {
+            return static_cast<node_t *>(right_pos.parent)->left().value;
+        }
+        left_t value{};
+        auto left_pos = _left_tree.locate(value);
+        if (!left_pos.found) {
+            node_t *node = create_node(std::move(value), key);
+            _right_tree.insert(right_pos, node);
+            _left_tree.insert(left_pos, node);
+            return node->left().value;
         }
-        return static_cast<typename left_tree::node *>(
-                static_cast<node_t *>(r_node))
-                ->value;
+        auto *node = static_cast<node_t *>(left_pos.parent);
+        relink_value(_right_tree, node->right(), key);
+        return node->left().value;
     }
 
     // lower и upper bound'ы по каждой стороне
@@ -686,25 +2393,116 @@ struct bimap {
         return _left_tree.lower_bound(left);
     }
 
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator lower_bound_left(K const &left) const {
+        return _left_tree.lower_bound(left);
+    }
+
     left_iterator upper_bound_left(const left_t &left) const {
-        auto it = lower_bound_left(left);
-        if (!_left_tree.comparator()(*it, left) &&
-            !_left_tree.comparator()(left, *it)) {
-            ++it;
-        }
-        return it;
+        return _left_tree.upper_bound(left);
     }
 
-    right_iterator lower_bound_right(const right_t &left) const {
-        return _right_tree.lower_bound(left);
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator upper_bound_left(K const &left) const {
+        return _left_tree.upper_bound(left);
     }
-    right_iterator upper_bound_right(const right_t &left) const {
-        auto it = lower_bound_right(left);
-        if (!_right_tree.comparator()(*it, left) &&
-            !_right_tree.comparator()(left, *it)) {
-            ++it;
-        }
-        return it;
+
+    right_iterator lower_bound_right(const right_t &right) const {
+        return _right_tree.lower_bound(right);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator lower_bound_right(K const &right) const {
+        return _right_tree.lower_bound(right);
+    }
+
+    right_iterator upper_bound_right(const right_t &right) const {
+        return _right_tree.upper_bound(right);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator upper_bound_right(K const &right) const {
+        return _right_tree.upper_bound(right);
+    }
+
+    // Порядковые статистики, требуют политики order_statistics.
+    // В splay-дереве неконстантные перегрузки поднимают пройденный узел в
+    // корень и стоят амортизированные O(log n); константные дерево не
+    // меняют и стоят O(глубины), до O(n) после вставок по возрастанию.
+    // В red_black обе за O(log n) в худшем случае.
+    // nth_*(k) -- k-й по порядку элемент стороны (с нуля) или end.
+    left_iterator nth_left(size_t k) const { return _left_tree.nth(k); }
+
+    left_iterator nth_left(size_t k) { return _left_tree.nth(k); }
+
+    right_iterator nth_right(size_t k) const { return _right_tree.nth(k); }
+
+    right_iterator nth_right(size_t k) { return _right_tree.nth(k); }
+
+    // Число элементов стороны, меньших key.
+    size_t rank_left(left_t const &key) const { return _left_tree.rank(key); }
+
+    size_t rank_left(left_t const &key) { return _left_tree.rank(key); }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    size_t rank_left(K const &key) const {
+        return _left_tree.rank(key);
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    size_t rank_left(K const &key) {
+        return _left_tree.rank(key);
+    }
+
+    size_t rank_right(right_t const &key) const { return _right_tree.rank(key); }
+
+    size_t rank_right(right_t const &key) { return _right_tree.rank(key); }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    size_t rank_right(K const &key) const {
+        return _right_tree.rank(key);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    size_t rank_right(K const &key) {
+        return _right_tree.rank(key);
+    }
+
+    // Число элементов стороны в [from, to), два вызова rank_*.
+    size_t count_range_left(left_t const &from, left_t const &to) const {
+        return count_range(_left_tree, from, to);
+    }
+
+    size_t count_range_left(left_t const &from, left_t const &to) {
+        return count_range(_left_tree, from, to);
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    size_t count_range_left(K const &from, K const &to) const {
+        return count_range(_left_tree, from, to);
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    size_t count_range_left(K const &from, K const &to) {
+        return count_range(_left_tree, from, to);
+    }
+
+    size_t count_range_right(right_t const &from, right_t const &to) const {
+        return count_range(_right_tree, from, to);
+    }
+
+    size_t count_range_right(right_t const &from, right_t const &to) {
+        return count_range(_right_tree, from, to);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    size_t count_range_right(K const &from, K const &to) const {
+        return count_range(_right_tree, from, to);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    size_t count_range_right(K const &from, K const &to) {
+        return count_range(_right_tree, from, to);
     }
 
     // Возващает итератор на минимальный по порядку left.
@@ -717,28 +2515,72 @@ struct bimap {
     // Возващает итератор на следующий за последним по порядку right.
     right_iterator end_right() const { return _right_tree.end(); }
 
+    allocator_type get_allocator() const {
+        return allocator_type(_pool.get_allocator());
+    }
+
     // Проверка на пустоту
-    bool empty() const { return begin_left() == end_left(); }
+    bool empty() const { return size() == 0; }
 
     // Возвращает размер бимапы (кол-во пар)
     std::size_t size() const { return _left_tree.size(); }
 
+    // Байты, занятые bimap: сам объект, блоки пула узлов вместе со
+    // свободными слотами и таблицы хешированных сторон.
+    // Память, которую значения выделяют сами (строки и т.п.), не входит.
+    size_t memory_usage() const {
+        return sizeof(bimap) + _pool.memory_usage() + _left_tree.memory_usage() +
+               _right_tree.memory_usage();
+    }
+
+    // Снимок и сброс счетчиков, требуют политики instrumented. Счетчики
+    // относятся к объекту: swap и перемещение их не переносят.
+    bimap_statistics statistics() const {
+        static_assert(measured, "statistics requires the instrumented policy");
+        bimap_statistics result;
+        if constexpr (!left_hashed) {
+            result.left = _left_tree.statistics();
+        }
+        if constexpr (!right_hashed) {
+            result.right = _right_tree.statistics();
+        }
+        _pool.read(result);
+        return result;
+    }
+
+    void reset_statistics() {
+        static_assert(measured, "reset_statistics requires the instrumented policy");
+        if constexpr (!left_hashed) {
+            _left_tree.reset_statistics();
+        }
+        if constexpr (!right_hashed) {
+            _right_tree.reset_statistics();
+        }
+        _pool.reset_statistics();
+    }
+
     // операторы сравнения
+    // Если хотя бы одна сторона хеширована, порядок обхода ничего не
+    // значит, и bimap'ы равны, когда каждая пара a есть в b.
     friend bool operator==(bimap const &a, bimap const &b) {
         if (a.size() != b.size()) {
             return false;
         }
-        auto lit = b.begin_left();
-        auto lit1 = a.begin_left();
-        for (; lit1 != a.end_left() && lit != b.end_left(); ++lit1, ++lit) {
-            if (*lit != *lit1)
-                return false;
+        if constexpr (any_hashed) {
+            for (auto it = a.begin_left(); it != a.end_left(); ++it) {
+                auto found = b.find_left(*it);
+                if (found == b.end_left() || *found.flip() != *it.flip()) {
+                    return false;
+                }
+            }
+            return true;
         }
-
-        auto rit = b.begin_right();
-        auto rit1 = a.begin_right();
-        for (; rit1 != a.end_right() && rit != b.end_right(); ++rit1, ++rit) {
-            if (*rit != *rit1)
+        // Одного обхода по left с парными right достаточно: совпадают и
+        // пары, и множество right. Обходы двух сторон по отдельности пары
+        // не сверяют ({(1, 2), (2, 1)} и {(1, 1), (2, 2)}).
+        auto lit = b.begin_left();
+        for (auto lit1 = a.begin_left(); lit1 != a.end_left(); ++lit1, ++lit) {
+            if (*lit != *lit1 || *lit.flip() != *lit1.flip())
                 return false;
         }
 
@@ -747,43 +2589,1126 @@ struct bimap {
 
     friend bool operator!=(bimap const &a, bimap const &b) { return !(a == b); }
 
+    // Алгебра над bimap одного типа. Все -- слияние обходов по left, как в
+    // operator==, а не поиск каждого ключа, поэтому левая сторона должна
+    // быть упорядоченной.
+    using delta_type = bimap_delta<Left, Right>;
+
+    // Что нужно сделать с from, чтобы получить to, за O(n + m).
+    friend delta_type diff(bimap const &from, bimap const &to) {
+        static_assert(!left_hashed, "diff requires an ordered left side");
+        delta_type delta;
+        auto const &less = from._left_tree.comparator();
+        auto a = from.begin_left();
+        auto b = to.begin_left();
+        while (a != from.end_left() || b != to.end_left()) {
+            if (b == to.end_left() || (a != from.end_left() && less(*a, *b))) {
+                delta.removed.emplace_back(*a, *a.flip());
+                ++a;
+            } else if (a == from.end_left() || less(*b, *a)) {
+                delta.added.emplace_back(*b, *b.flip());
+                ++b;
+            } else {
+                if (!from.same_right(*a.flip(), *b.flip())) {
+                    delta.remapped.push_back({*a, *a.flip(), *b.flip()});
+                }
+                ++a;
+                ++b;
+            }
+        }
+        return delta;
+    }
+
+    // Применяет разницу, полученную diff(*this, to): сначала все удаления
+    // (removed и старые пары remapped), затем одна пакетная вставка --
+    // поэтому right может переходить между парами. O(k log n + k log k)
+    // поштучно на k изменений либо O(n + k log k) слиянием при больших k.
+    // Возвращает, совпало ли содержимое с ожидаемым delta: если нет, пары,
+    // которых нет в ожидаемом виде, не удаляются, конфликтующие вставки
+    // пропускаются, остальное применяется. Базовая гарантия исключений:
+    // удаления могут остаться выполненными.
+    bool apply(delta_type const &delta) {
+        static_assert(!left_hashed, "apply requires an ordered left side");
+        bool matched = true;
+        auto erase_pair = [&](left_t const &left, right_t const &right) {
+            auto it = find_left(left);
+            if (it == end_left() || !same_right(*it.flip(), right)) {
+                matched = false;
+                return;
+            }
+            erase_left(it);
+        };
+        for (auto const &pair : delta.removed) {
+            erase_pair(pair.first, pair.second);
+        }
+        for (auto const &change : delta.remapped) {
+            erase_pair(change.left, change.from);
+        }
+        pair_refs inserted;
+        inserted.reserve(delta.added.size() + delta.remapped.size());
+        for (auto const &pair : delta.added) {
+            inserted.emplace_back(&pair.first, &pair.second);
+        }
+        for (auto const &change : delta.remapped) {
+            inserted.emplace_back(&change.left, &change.to);
+        }
+        size_t const expected = size() + inserted.size();
+        insert_copies(inserted, false);
+        return matched && size() == expected;
+    }
+
+    // Пары a и те пары b, чьих left и right в a нет. При конфликте по
+    // right побеждает a, как при вставке b в копию a. O(n + m) слиянием
+    // плюс сортировка добавляемых пар по right.
+    friend bimap merge_union(bimap const &a, bimap const &b) {
+        static_assert(!left_hashed, "merge_union requires an ordered left side");
+        auto const &less = a._left_tree.comparator();
+        pair_refs extra;
+        auto x = a.begin_left();
+        for (auto y = b.begin_left(); y != b.end_left(); ++y) {
+            while (x != a.end_left() && less(*x, *y)) {
+                ++x;
+            }
+            if (x == a.end_left() || less(*y, *x)) {
+                extra.emplace_back(&*y, &*y.flip());
+            }
+        }
+        bimap result(a);
+        result.insert_copies(extra, true);
+        return result;
+    }
+
+    // Пары, которые есть и в a, и в b (совпадают и left, и right), за
+    // O(n + m): слиянием обходов по left находятся общие пары в порядке
+    // left, слиянием по right -- те же пары в порядке right, и оба дерева
+    // строятся сразу сбалансированными, как при копировании.
+    friend bimap intersect(bimap const &a, bimap const &b) {
+        static_assert(!left_hashed, "intersect requires an ordered left side");
+        auto const &less = a._left_tree.comparator();
+        bimap result(a._left_tree.comparator(), a._right_tree.comparator(),
+                     std::allocator_traits<Allocator>::select_on_container_copy_construction(
+                             a.get_allocator()));
+        if constexpr (right_hashed) {
+            pair_refs common;
+            auto x = a.begin_left();
+            for (auto y = b.begin_left(); y != b.end_left(); ++y) {
+                while (x != a.end_left() && less(*x, *y)) {
+                    ++x;
+                }
+                if (x != a.end_left() && !less(*y, *x) && a.same_right(*x.flip(), *y.flip())) {
+                    common.emplace_back(&*x, &*x.flip());
+                }
+            }
+            result.insert_copies(common, true);
+            return result;
+        } else {
+            std::vector<node_t *> by_left;
+            std::vector<node_t *> by_right;
+            copy_index index(std::min(a.size(), b.size()));
+            // Копии не лежат ни в одном дереве, пока оба порядка не собраны:
+            // если бросит любой из компараторов, они разрушаются здесь.
+            try {
+                auto x = a.begin_left();
+                for (auto y = b.begin_left(); y != b.end_left(); ++y) {
+                    while (x != a.end_left() && less(*x, *y)) {
+                        ++x;
+                    }
+                    if (x != a.end_left() && !less(*y, *x) &&
+                        a.same_right(*x.flip(), *y.flip())) {
+                        auto *original = static_cast<node_t *>(x.node());
+                        node_t *copy = result.create_node(original->left().value,
+                                                          original->right().value);
+                        by_left.push_back(copy);
+                        index.insert(original, copy);
+                    }
+                }
+
+                auto const &right_less = a._right_tree.comparator();
+                by_right.reserve(by_left.size());
+                auto z = a.begin_right();
+                for (auto y = b.begin_right(); y != b.end_right(); ++y) {
+                    while (z != a.end_right() && right_less(*z, *y)) {
+                        ++z;
+                    }
+                    if (z != a.end_right() && !right_less(*y, *z) &&
+                        !less(*z.flip(), *y.flip()) && !less(*y.flip(), *z.flip())) {
+                        by_right.push_back(index.find(static_cast<node_t *>(z.node())));
+                    }
+                }
+            } catch (...) {
+                for (node_t *copy : by_left) {
+                    result._pool.destroy(copy);
+                }
+                throw;
+            }
+            result._left_tree.build(by_left.begin(), by_left.end());
+            result._right_tree.build(by_right.begin(), by_right.end());
+            return result;
+        }
+    }
+
 private:
-    template <class L, class R>
-    std::unique_ptr<node_t> create_node(L &&l, R &&r) {
-        return std::make_unique<node_t>(std::forward<L>(l), std::forward<R>(r),
-                                        _dummy);
+    // Пул узлов: выдает память под node_t блоками, размер которых растет
+    // геометрически, и переиспользует узлы, освобожденные erase.
+    // Блоки берутся у аллокатора, пустой пул ничего не аллоцирует.
+    // node_handle может пережить bimap, поэтому блоки принадлежат не пулу,
+    // а арене со счетчиком ссылок: ссылку держат пул и каждый node_handle,
+    // извлеченный из него. Блоки освобождаются разом, когда на арену не
+    // остается ссылок.
+    // Узел из чужой арены (node_handle, merge) перевешивается без переноса,
+    // а пул принимает ссылку на его арену (cover) и считает ее узлы у себя.
+    // Чужой узел при удалении не идет в список свободных: когда у пула не
+    // остается узлов арены, ссылка на нее отпускается. Так арена держится,
+    // пока живы перевешенные из нее узлы, а не до разрушения пула, и
+    // принимаются только арены перевешенных узлов. Чтобы находить арену
+    // узла, принявший пул ведет индекс блоков: своих и тех чужих, в которых
+    // лежат его узлы. Пока чужих узлов нет, индекс пуст, и проверка стоит
+    // одного сравнения.
+    struct node_pool : private node_allocator, pool_counters<measured> {
+        using traits = std::allocator_traits<node_allocator>;
+
+        static constexpr size_t min_block = 8;
+        static constexpr size_t max_block = 4096;
+
+        // Заголовок блока лежит в его первом слоте и после публикации не
+        // меняется, поэтому список блоков чужой арены можно обходить, пока
+        // владелец добавляет в него новые.
+        struct block {
+            block *next;
+            size_t capacity;
+
+            node_t *begin() { return reinterpret_cast<node_t *>(this) + 1; }
+            node_t *end() { return begin() + capacity; }
+        };
+
+        struct arena {
+            explicit arena(node_allocator const &alloc) : alloc(alloc) {}
+
+            node_allocator alloc;
+            std::atomic<block *> blocks{};
+            std::atomic<size_t> refs{1};
+        };
+
+        explicit node_pool(node_allocator const &alloc)
+                : node_allocator(alloc), _ranges(range_allocator(alloc)),
+                  _adopted(adopted_allocator(alloc)) {}
+        node_pool(node_pool const &) = delete;
+        node_pool &operator=(node_pool const &) = delete;
+
+        ~node_pool() {
+            release(_arena);
+            for (adopted_arena const &adopted : _adopted) {
+                release(adopted.owner);
+            }
+        }
+
+        node_allocator const &get_allocator() const { return *this; }
+
+        template <class... Args> node_t *create(Args &&...args) {
+            node_t *place = allocate();
+            try {
+                traits::construct(*this, place, std::forward<Args>(args)...);
+            } catch (...) {
+                deallocate(place);
+                throw;
+            }
+            return place;
+        }
+
+        void destroy(node_t *n) {
+            destroy_value(n);
+            recycle(n);
+        }
+
+        // Разрушает значение в узле, не возвращая его память в пул.
+        void destroy_value(node_t *n) { traits::destroy(*this, n); }
+
+        // Возвращает в пул память узла, значение которого уже разрушено.
+        // Узлы, возвращенные последними, выдаются первыми. Слот чужого узла
+        // остается в его арене.
+        void recycle(node_t *n) {
+            if (_ranges.empty()) {
+                deallocate(n);
+                return;
+            }
+            arena *a = arena_of(n);
+            if (a == _arena) {
+                deallocate(n);
+            } else {
+                drop(a);
+            }
+        }
+
+        // Ссылка на арену узла n, который покидает пул.
+        arena *share(node_t *n) {
+            arena *a = arena_of(n);
+            retain(a);
+            forget(a);
+            return a;
+        }
+
+        // Узел арены a покинул пул без разрушения (merge в другой bimap).
+        void forget(arena *a) {
+            if (a != _arena) {
+                drop(a);
+            }
+        }
+
+        // Арена, в которой лежит узел n этого пула.
+        arena *arena_of(node_t *n) const {
+            if (_ranges.empty()) {
+                return _arena;
+            }
+            auto it = std::upper_bound(
+                    _ranges.begin(), _ranges.end(), n,
+                    [](node_t *p, block_range const &r) { return p < r.begin; });
+            return std::prev(it)->owner;
+        }
+
+        // Принимает узел n из арены a: пул держит ссылку на a, пока у него
+        // есть ее узлы, а блок n есть в индексе. Ссылку вызывающего cover не
+        // забирает. Память под индекс резервируется до изменений: если она
+        // бросит, пул остается прежним.
+        void cover(node_t *n, arena *a) {
+            if (a == _arena) {
+                return;
+            }
+            auto adopted = find_adopted(a);
+            bool const known = adopted != _adopted.end() && adopted->owner == a;
+            if (known && indexed(n)) {
+                ++adopted->nodes;
+                return;
+            }
+            bool const first = _ranges.empty();
+            size_t needed = _ranges.size() + 1;
+            if (first && _arena != nullptr) {
+                for (block *b = _arena->blocks.load(std::memory_order_relaxed); b != nullptr;
+                     b = b->next) {
+                    ++needed;
+                }
+            }
+            _ranges.reserve(needed);
+            if (!known) {
+                size_t const at = static_cast<size_t>(adopted - _adopted.begin());
+                _adopted.reserve(_adopted.size() + 1);
+                adopted = _adopted.begin() + static_cast<std::ptrdiff_t>(at);
+            }
+            if (first && _arena != nullptr) {
+                for (block *b = _arena->blocks.load(std::memory_order_relaxed); b != nullptr;
+                     b = b->next) {
+                    add_range(b, _arena);
+                }
+            }
+            if (!indexed(n)) {
+                add_range(block_of(n, a), a);
+            }
+            if (known) {
+                ++adopted->nodes;
+            } else {
+                retain(a);
+                _adopted.insert(adopted, adopted_arena{a, 1});
+            }
+        }
+
+        // Узлы с этим аллокатором можно перевешивать: их значения созданы
+        // тем же аллокатором. Узлы других аллокаторов переносятся.
+        bool compatible(node_allocator const &alloc) const { return alloc == get_allocator(); }
+
+        // Создает в своей арене копию узла n, перемещая значения (копируя,
+        // если перемещение может бросить). Узел n не меняется, если
+        // создание бросило исключение.
+        node_t *relocate(node_t *n) {
+            return create(std::move_if_noexcept(n->left().value),
+                          std::move_if_noexcept(n->right().value));
+        }
+
+        // Разрушает узел, которым владеет node_handle, и отпускает его
+        // ссылку на арену. Слот узла освобождается вместе с блоком.
+        static void dispose(node_t *n, arena *a) {
+            traits::destroy(a->alloc, n);
+            release(a);
+        }
+
+        static void retain(arena *a) {
+            if (a != nullptr) {
+                a->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        static void release(arena *a) {
+            if (a == nullptr || a->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                return;
+            }
+            block *b = a->blocks.load(std::memory_order_relaxed);
+            while (b != nullptr) {
+                block *next = b->next;
+                traits::deallocate(a->alloc, reinterpret_cast<node_t *>(b), b->capacity + 1);
+                b = next;
+            }
+            typename traits::template rebind_alloc<arena> arena_alloc(a->alloc);
+            std::allocator_traits<decltype(arena_alloc)>::destroy(arena_alloc, a);
+            std::allocator_traits<decltype(arena_alloc)>::deallocate(arena_alloc, a, 1);
+        }
+
+        // Блоки своей и принятых арен со служебными структурами.
+        size_t memory_usage() const {
+            size_t bytes = arena_bytes(_arena);
+            for (adopted_arena const &adopted : _adopted) {
+                bytes += arena_bytes(adopted.owner);
+            }
+            return bytes + _ranges.capacity() * sizeof(block_range) +
+                   _adopted.capacity() * sizeof(adopted_arena);
+        }
+
+        void swap(node_pool &other) noexcept {
+            if constexpr (std::is_move_assignable_v<node_allocator>) {
+                std::swap(static_cast<node_allocator &>(*this),
+                          static_cast<node_allocator &>(other));
+            }
+            std::swap(_arena, other._arena);
+            std::swap(_free, other._free);
+            std::swap(_cursor, other._cursor);
+            std::swap(_limit, other._limit);
+            _ranges.swap(other._ranges);
+            _adopted.swap(other._adopted);
+        }
+
+    private:
+        struct free_slot {
+            free_slot *next;
+        };
+
+        // Блок в индексе: [begin, end) и арена, которой он принадлежит.
+        struct block_range {
+            node_t *begin;
+            node_t *end;
+            arena *owner;
+        };
+
+        // Принятая арена и число ее узлов в пуле.
+        struct adopted_arena {
+            arena *owner;
+            size_t nodes;
+        };
+
+        using range_allocator = typename traits::template rebind_alloc<block_range>;
+        using adopted_allocator = typename traits::template rebind_alloc<adopted_arena>;
+
+        static_assert(sizeof(block) <= sizeof(node_t));
+        static_assert(sizeof(free_slot) <= sizeof(node_t));
+
+        node_t *allocate() {
+            if (_free != nullptr) {
+                free_slot *slot = _free;
+                _free = slot->next;
+                return reinterpret_cast<node_t *>(slot);
+            }
+            if (_cursor == _limit) {
+                if (_arena == nullptr) {
+                    create_arena();
+                }
+                if (!_ranges.empty()) {
+                    _ranges.reserve(_ranges.size() + 1);
+                }
+                block *head = _arena->blocks.load(std::memory_order_relaxed);
+                size_t capacity =
+                        head == nullptr ? min_block : std::min(head->capacity * 2, max_block);
+                node_t *memory = traits::allocate(*this, capacity + 1);
+                this->note_allocation((capacity + 1) * sizeof(node_t));
+                block *b = new (memory) block{head, capacity};
+                _arena->blocks.store(b, std::memory_order_release);
+                if (!_ranges.empty()) {
+                    add_range(b, _arena);
+                }
+                _cursor = b->begin();
+                _limit = b->end();
+            }
+            return _cursor++;
+        }
+
+        void deallocate(node_t *n) { _free = new (n) free_slot{_free}; }
+
+        void create_arena() {
+            typename traits::template rebind_alloc<arena> arena_alloc(*this);
+            using arena_traits = std::allocator_traits<decltype(arena_alloc)>;
+            arena *a = arena_traits::allocate(arena_alloc, 1);
+            this->note_allocation(sizeof(arena));
+            arena_traits::construct(arena_alloc, a, get_allocator());
+            _arena = a;
+        }
+
+        auto find_adopted(arena *a) {
+            return std::lower_bound(
+                    _adopted.begin(), _adopted.end(), a,
+                    [](adopted_arena const &x, arena *p) { return x.owner < p; });
+        }
+
+        // У пула стало на один узел арены a меньше. Последний отпускает
+        // ссылку на a и убирает ее блоки из индекса; без чужих арен индекс
+        // пустеет, и пул снова не ищет арену узла.
+        void drop(arena *a) noexcept {
+            auto adopted = find_adopted(a);
+            if (--adopted->nodes != 0) {
+                return;
+            }
+            _adopted.erase(adopted);
+            if (_adopted.empty()) {
+                _ranges.clear();
+            } else {
+                _ranges.erase(std::remove_if(_ranges.begin(), _ranges.end(),
+                                             [a](block_range const &r) { return r.owner == a; }),
+                              _ranges.end());
+            }
+            release(a);
+        }
+
+        bool indexed(node_t *n) const {
+            auto it = std::upper_bound(
+                    _ranges.begin(), _ranges.end(), n,
+                    [](node_t *p, block_range const &r) { return p < r.begin; });
+            return it != _ranges.begin() && n < std::prev(it)->end;
+        }
+
+        // Блок арены a, в котором лежит n. Чужая арена может расти в это
+        // время: новые блоки публикуются в голову списка с release.
+        static block *block_of(node_t *n, arena *a) {
+            block *b = a->blocks.load(std::memory_order_acquire);
+            while (!(b->begin() <= n && n < b->end())) {
+                b = b->next;
+            }
+            return b;
+        }
+
+        void add_range(block *b, arena *owner) {
+            block_range range{b->begin(), b->end(), owner};
+            auto it = std::upper_bound(
+                    _ranges.begin(), _ranges.end(), range.begin,
+                    [](node_t *p, block_range const &r) { return p < r.begin; });
+            _ranges.insert(it, range);
+        }
+
+        static size_t arena_bytes(arena *a) {
+            if (a == nullptr) {
+                return 0;
+            }
+            size_t bytes = sizeof(arena);
+            for (block *b = a->blocks.load(std::memory_order_acquire); b != nullptr;
+                 b = b->next) {
+                bytes += (b->capacity + 1) * sizeof(node_t);
+            }
+            return bytes;
+        }
+
+        arena *_arena{};
+        free_slot *_free{};
+        node_t *_cursor{};
+        node_t *_limit{};
+        // Индекс блоков по адресу, пустой, пока у пула нет чужих узлов, и
+        // принятые арены по адресу.
+        std::vector<block_range, range_allocator> _ranges;
+        std::vector<adopted_arena, adopted_allocator> _adopted;
+    };
+
+    template <class L, class R> node_t *create_node(L &&l, R &&r) {
+        return _pool.create(std::forward<L>(l), std::forward<R>(r));
+    }
+
+    template <class L, class R> left_iterator insert_pair(L &&left, R &&right) {
+        auto left_pos = _left_tree.locate(left);
+        if (left_pos.found) {
+            return end_left();
+        }
+        auto right_pos = _right_tree.locate(right);
+        if (right_pos.found) {
+            return end_left();
+        }
+        node_t *node = create_node(std::forward<L>(left), std::forward<R>(right));
+        _right_tree.insert(right_pos, node);
+        return _left_tree.insert(left_pos, node);
+    }
+
+    // Вставляет уже созданный узел. Если его left или right заняты, узел
+    // возвращается в пул и результат -- end_left().
+    left_iterator link_node(node_t *node) {
+        auto left_pos = _left_tree.locate(node->left().value);
+        auto right_pos = left_pos.found ? typename right_tree::position{}
+                                        : _right_tree.locate(node->right().value);
+        if (left_pos.found || right_pos.found) {
+            _pool.destroy(node);
+            return end_left();
+        }
+        _right_tree.insert(right_pos, node);
+        return _left_tree.insert(left_pos, node);
+    }
+
+    // Tree -- константное дерево или нет, от этого зависит splay при поиске.
+    template <class Tree, class K>
+    static node_t *at_key(Tree &tree, K const &key, char const *message) {
+        auto found = tree.find(key);
+        if (found == tree.end()) {
+            throw std::out_of_range{message};
+        }
+        return static_cast<node_t *>(found._node);
+    }
+
+    // Меньшие части не окупают запуск потока.
+    static constexpr size_t parallel_min_chunk = 16384;
+
+    template <class It, class Out, class Run>
+    static Out parallel_many(It first, It last, Out out, Run run) {
+        size_t const count = static_cast<size_t>(last - first);
+        size_t const threads = std::min<size_t>(
+                std::max(1u, std::thread::hardware_concurrency()), count / parallel_min_chunk);
+        if (threads <= 1) {
+            return run(first, last, out);
+        }
+        size_t const chunk = (count + threads - 1) / threads;
+        std::vector<std::exception_ptr> errors(threads);
+        auto part = [&](size_t t) {
+            size_t const begin = std::min(count, t * chunk);
+            size_t const end = std::min(count, begin + chunk);
+            try {
+                run(first + begin, first + end, out + begin);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        try {
+            for (size_t t = 1; t < threads; ++t) {
+                workers.emplace_back(part, t);
+            }
+        } catch (...) {
+            for (auto &worker : workers) {
+                worker.join();
+            }
+            throw;
+        }
+        part(0);
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        for (auto const &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return out + count;
+    }
+
+    static size_t ceil_log2(size_t n) {
+        size_t log = 0;
+        while ((size_t{1} << log) < n) {
+            ++log;
+        }
+        return log;
+    }
+
+    // С хешированной стороной вырезать и перестраивать нечего: узлы
+    // удаляются поштучно за O(1) в среднем на сторону.
+    template <class Primary, class Secondary>
+    void erase_range(Primary &primary, Secondary &secondary,
+                     typename Primary::iterator first, typename Primary::iterator last) {
+        if constexpr (any_hashed) {
+            while (first != last) {
+                auto *n = static_cast<node_t *>(first._node);
+                ++first;
+                primary.erase(n);
+                secondary.erase(n);
+                _pool.destroy(n);
+            }
+        } else {
+            cut_range(primary, secondary, first, last);
+        }
+    }
+
+    template <class Primary, class Secondary>
+    void cut_range(Primary &primary, Secondary &secondary,
+                   typename Primary::iterator first, typename Primary::iterator last) {
+        if (first == last) {
+            return;
+        }
+        std::vector<node_t *> removed;
+        for (auto it = first; it != last; ++it) {
+            removed.push_back(static_cast<node_t *>(it._node));
+        }
+        size_t const k = removed.size();
+        // Обход дерева при перестройке -- промах кэша на узел, поштучное
+        // удаление -- примерно log n промахов, но верхние уровни в кэше.
+        bool const rebuild = k * ceil_log2(secondary.size()) >= 2 * secondary.size();
+        std::vector<node_t *> kept;
+        if (rebuild) {
+            kept.reserve(secondary.size() - k);
+        }
+
+        primary.cut(first._node, last._node, k);
+        if (rebuild) {
+            // Вырезанные узлы помечаются нулевым parent в primary: у узлов
+            // дерева он никогда не нулевой.
+            for (node_t *n : removed) {
+                static_cast<typename Primary::node *>(n)->parent = nullptr;
+            }
+            for (auto it = secondary.begin(); it != secondary.end(); ++it) {
+                auto *n = static_cast<node_t *>(it._node);
+                if (static_cast<typename Primary::node *>(n)->parent != nullptr) {
+                    kept.push_back(n);
+                }
+            }
+            secondary.build(kept.begin(), kept.end());
+        } else {
+            for (node_t *n : removed) {
+                secondary.erase(n);
+            }
+        }
+        for (node_t *n : removed) {
+            _pool.destroy(n);
+        }
+    }
+
+    node_handle extract(node_t *n) {
+        _left_tree.erase(n);
+        _right_tree.erase(n);
+        return node_handle(n, _pool.share(n));
+    }
+
+    template <class Tree, class K> node_handle extract_key(Tree &tree, K const &key) {
+        auto found = std::as_const(tree).find(key);
+        if (found == tree.end()) {
+            return node_handle();
+        }
+        return extract(static_cast<node_t *>(found._node));
+    }
+
+    // Tree может быть константным: тогда rank не меняет дерево.
+    template <class Tree, class K>
+    static size_t count_range(Tree &tree, K const &from, K const &to) {
+        size_t begin = tree.rank(from);
+        size_t end = tree.rank(to);
+        return end > begin ? end - begin : 0;
+    }
+
+    template <class Tree, class K> bool erase_key(Tree &tree, K const &key) {
+        auto found = std::as_const(tree).find(key);
+        if (found == tree.end()) {
+            return false;
+        }
+        auto *n = static_cast<node_t *>(found._node);
+        _left_tree.erase(n);
+        _right_tree.erase(n);
+        _pool.destroy(n);
+        return true;
+    }
+
+    // Меняет значение узла одной из сторон и переставляет узел в дереве на
+    // новое место (см. relink деревьев). Значение копируется до изменений,
+    // а место ищется до удаления узла: если бросит копирование или
+    // компаратор, дерево не меняется, и пара остается в обоих деревьях.
+    template <class Tree>
+    static void relink_value(Tree &tree, typename Tree::node &node,
+                             typename Tree::type const &value) {
+        tree.relink(&node, typename Tree::type(value));
+    }
+
+    template <class InputIt>
+    void bulk_insert(InputIt first, InputIt last, bool left_sorted) {
+        std::vector<node_t *> fresh;
+        if constexpr (std::is_base_of_v<
+                              std::forward_iterator_tag,
+                              typename std::iterator_traits<InputIt>::iterator_category>) {
+            fresh.reserve(static_cast<size_t>(std::distance(first, last)));
+        }
+        try {
+            for (; first != last; ++first) {
+                auto &&pair = *first;
+                fresh.push_back(nullptr);
+                fresh.back() =
+                        create_node(std::get<0>(std::forward<decltype(pair)>(pair)),
+                                    std::get<1>(std::forward<decltype(pair)>(pair)));
+            }
+            link_fresh(fresh, left_sorted);
+        } catch (...) {
+            for (node_t *n : fresh) {
+                if (n != nullptr) {
+                    _pool.destroy(n);
+                }
+            }
+            throw;
+        }
+    }
+
+    // Пары по ссылкам на значения чужих узлов или delta.
+    using pair_refs = std::vector<std::pair<left_t const *, right_t const *>>;
+
+    // insert_range для копий пар pairs.
+    void insert_copies(pair_refs const &pairs, bool left_sorted) {
+        std::vector<node_t *> fresh;
+        fresh.reserve(pairs.size());
+        try {
+            for (auto const &pair : pairs) {
+                fresh.push_back(nullptr);
+                fresh.back() = create_node(*pair.first, *pair.second);
+            }
+            link_fresh(fresh, left_sorted);
+        } catch (...) {
+            for (node_t *n : fresh) {
+                if (n != nullptr) {
+                    _pool.destroy(n);
+                }
+            }
+            throw;
+        }
+    }
+
+    // Равенство right в смысле компаратора правой стороны.
+    bool same_right(right_t const &x, right_t const &y) const {
+        auto const &compare = _right_tree.comparator();
+        if constexpr (right_hashed) {
+            return compare.equal(x, y);
+        } else {
+            return !compare(x, y) && !compare(y, x);
+        }
+    }
+
+    // Вставляет созданные, но еще не связанные узлы fresh (в порядке
+    // вставки). Отвергнутые узлы возвращаются в пул, а обработанные узлы
+    // зануляются в fresh, чтобы при исключении их не уничтожили повторно.
+    // Хешированной стороне сортировка не нужна: узлы вставляются по одному,
+    // таблица расширяется заранее под весь диапазон.
+    void link_fresh(std::vector<node_t *> &fresh, bool left_sorted) {
+        if constexpr (any_hashed) {
+            if constexpr (left_hashed) {
+                _left_tree.reserve(size() + fresh.size());
+            }
+            if constexpr (right_hashed) {
+                _right_tree.reserve(size() + fresh.size());
+            }
+            link_each(fresh);
+        } else {
+            merge_fresh(fresh, left_sorted);
+        }
+    }
+
+    // Поэлементная вставка. Если бросит компаратор или хеш, уже связанные
+    // узлы вынимаются из деревьев (удаление не сравнивает) и остаются в
+    // fresh, так что bimap не меняется.
+    void link_each(std::vector<node_t *> &fresh) {
+        size_t done = 0;
+        try {
+            for (; done < fresh.size(); ++done) {
+                if (link_node(fresh[done]) == end_left()) {
+                    fresh[done] = nullptr;
+                }
+            }
+        } catch (...) {
+            for (size_t i = 0; i < done; ++i) {
+                if (fresh[i] != nullptr) {
+                    _left_tree.erase(fresh[i]);
+                    _right_tree.erase(fresh[i]);
+                }
+            }
+            throw;
+        }
+        for (node_t *&n : fresh) {
+            n = nullptr;
+        }
+    }
+
+    void merge_fresh(std::vector<node_t *> &fresh, bool left_sorted) {
+        size_t const k = fresh.size();
+        if (k == 0) {
+            return;
+        }
+
+        if (k * ceil_log2(size()) < size()) {
+            link_each(fresh);
+            return;
+        }
+
+        std::vector<size_t> by_left(k), by_right(k);
+        std::vector<size_t> left_class(k), right_class(k);
+        std::vector<char> left_taken(k), right_taken(k);
+        classify(_left_tree, fresh, left_sorted, by_left, left_class, left_taken);
+        classify(_right_tree, fresh, false, by_right, right_class, right_taken);
+
+        std::vector<char> accepted(k);
+        size_t accepted_count = 0;
+        for (size_t i = 0; i < k; ++i) {
+            if (!left_taken[left_class[i]] && !right_taken[right_class[i]]) {
+                accepted[i] = left_taken[left_class[i]] = right_taken[right_class[i]] = 1;
+                ++accepted_count;
+            }
+        }
+
+        std::vector<node_t *> left_order =
+                merged_order(_left_tree, fresh, by_left, accepted, accepted_count);
+        std::vector<node_t *> right_order =
+                merged_order(_right_tree, fresh, by_right, accepted, accepted_count);
+
+        _left_tree.build(left_order.begin(), left_order.end());
+        _right_tree.build(right_order.begin(), right_order.end());
+        for (size_t i = 0; i < k; ++i) {
+            if (!accepted[i]) {
+                _pool.destroy(fresh[i]);
+            }
+            fresh[i] = nullptr;
+        }
+    }
+
+    // Упорядочивает узлы fresh по стороне Tree (order -- их номера по
+    // возрастанию) и разбивает их на классы равных значений: cls[i] -- класс
+    // узла i, taken[c] -- значение класса c уже есть в дереве. Проверка против
+    // дерева -- один проход слияния по его элементам.
+    template <class Tree>
+    static void classify(Tree const &tree, std::vector<node_t *> const &fresh,
+                         bool sorted, std::vector<size_t> &order,
+                         std::vector<size_t> &cls, std::vector<char> &taken) {
+        auto const &less = tree.comparator();
+        auto value = [&](size_t i) -> typename Tree::type const & {
+            return static_cast<typename Tree::node *>(fresh[i])->value;
+        };
+
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        if (!sorted) {
+            std::sort(order.begin(), order.end(),
+                      [&](size_t a, size_t b) { return less(value(a), value(b)); });
+        }
+
+        auto existing = tree.begin();
+        for (size_t j = 0; j < order.size(); ++j) {
+            size_t i = order[j];
+            if (j > 0 && !less(value(order[j - 1]), value(i))) {
+                cls[i] = cls[order[j - 1]];
+                continue;
+            }
+            cls[i] = j;
+            while (existing != tree.end() && less(*existing, value(i))) {
+                ++existing;
+            }
+            taken[j] = existing != tree.end() && !less(value(i), *existing);
+        }
+    }
+
+    // Сливает узлы дерева Tree с принятыми узлами fresh в один
+    // упорядоченный по стороне Tree список.
+    template <class Tree>
+    static std::vector<node_t *> merged_order(Tree const &tree,
+                                              std::vector<node_t *> const &fresh,
+                                              std::vector<size_t> const &order,
+                                              std::vector<char> const &accepted,
+                                              size_t accepted_count) {
+        auto const &less = tree.comparator();
+        std::vector<node_t *> result;
+        result.reserve(tree.size() + accepted_count);
+
+        auto existing = tree.begin();
+        for (size_t i : order) {
+            if (!accepted[i]) {
+                continue;
+            }
+            auto const &value = static_cast<typename Tree::node *>(fresh[i])->value;
+            while (existing != tree.end() && less(*existing, value)) {
+                result.push_back(static_cast<node_t *>(existing._node));
+                ++existing;
+            }
+            result.push_back(fresh[i]);
+        }
+        for (; existing != tree.end(); ++existing) {
+            result.push_back(static_cast<node_t *>(existing._node));
+        }
+        return result;
     }
 
-    void delete_tree(node_t *n) {
-        if (n == _dummy) {
+    // Копирует пары пустого *this из other. Узлы создаются в порядке left,
+    // а порядок right восстанавливается по таблице "оригинал -> копия", так что
+    // компараторы не вызываются. Если копирование значения бросит исключение,
+    // созданные узлы возвращаются в пул.
+    void copy_nodes(bimap const &other) {
+        if (other.empty()) {
             return;
         }
+        if constexpr (any_hashed) {
+            copy_unordered(other);
+        } else {
+            copy_ordered(other);
+        }
+    }
+
+    void copy_ordered(bimap const &other) {
+        size_t const n = other.size();
+        std::vector<node_t *> by_left;
+        std::vector<node_t *> by_right;
+        by_left.reserve(n);
+        by_right.reserve(n);
+        copy_index index(n);
+
+        try {
+            for (auto it = other.begin_left(); it != other.end_left(); ++it) {
+                auto *original = static_cast<node_t *>(it.node());
+                node_t *copy =
+                        create_node(original->left().value, original->right().value);
+                by_left.push_back(copy);
+                index.insert(original, copy);
+            }
+        } catch (...) {
+            for (node_t *copy : by_left) {
+                _pool.destroy(copy);
+            }
+            throw;
+        }
+
+        for (auto it = other.begin_right(); it != other.end_right(); ++it) {
+            by_right.push_back(index.find(static_cast<node_t *>(it.node())));
+        }
+
+        _left_tree.build(by_left.begin(), by_left.end());
+        _right_tree.build(by_right.begin(), by_right.end());
+    }
+
+    // Копирование с хешированной стороной: узлы создаются в порядке
+    // упорядоченной стороны, если она есть, и обе стороны строятся из одного
+    // списка; таблицы расширяются до построения, так что после создания
+    // копий ничего не бросает.
+    void copy_unordered(bimap const &other) {
+        std::vector<node_t *> copies;
+        copies.reserve(other.size());
+        auto copy_from = [&](auto first, auto last) {
+            for (; first != last; ++first) {
+                auto *original = static_cast<node_t *>(first.node());
+                copies.push_back(
+                        create_node(original->left().value, original->right().value));
+            }
+        };
+        try {
+            if constexpr (left_hashed && !right_hashed) {
+                copy_from(other.begin_right(), other.end_right());
+            } else {
+                copy_from(other.begin_left(), other.end_left());
+            }
+            if constexpr (left_hashed) {
+                _left_tree.reserve(copies.size());
+            }
+            if constexpr (right_hashed) {
+                _right_tree.reserve(copies.size());
+            }
+        } catch (...) {
+            for (node_t *copy : copies) {
+                _pool.destroy(copy);
+            }
+            throw;
+        }
+        _left_tree.build(copies.begin(), copies.end());
+        _right_tree.build(copies.begin(), copies.end());
+    }
+
+    // Хеш-таблица с открытой адресацией "узел other -> его копия". Сам
+    // оригинал не хранится: пока копия не вставлена в дерево, он лежит в ее
+    // right().parent.
+    struct copy_index {
+        explicit copy_index(size_t n) {
+            while ((size_t{1} << _bits) < 2 * n) {
+                ++_bits;
+            }
+            _slots.assign(size_t{1} << _bits, nullptr);
+        }
+
+        void insert(node_t *original, node_t *copy) {
+            copy->right().parent = original;
+            size_t i = slot(original);
+            while (_slots[i] != nullptr) {
+                i = (i + 1) & (_slots.size() - 1);
+            }
+            _slots[i] = copy;
+        }
+
+        node_t *find(node_t *original) const {
+            size_t i = slot(original);
+            while (_slots[i]->right().parent != original) {
+                i = (i + 1) & (_slots.size() - 1);
+            }
+            return _slots[i];
+        }
+
+    private:
+        size_t slot(node_t *original) const {
+            auto key = static_cast<std::uint64_t>(
+                    reinterpret_cast<std::uintptr_t>(original));
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - _bits));
+        }
 
-        delete_tree(static_cast<node_t *>(n->left().left));
-        delete_tree(static_cast<node_t *>(n->left().right));
-        delete n;
+        unsigned _bits = 1;
+        std::vector<node_t *> _slots;
+    };
+
+    // Передает release каждый узел и разбирает левое дерево: пока у узла
+    // есть левый ребенок, поворот вправо поднимает его, иначе узел
+    // отдается release и разбор продолжается с правого ребенка. Каждый
+    // поворот навсегда уменьшает левую ветвь, так что всего O(n) шагов и
+    // O(1) памяти даже на дереве-цепочке. Связи дерева после этого не
+    // определены.
+    template <class Release> void dismantle(Release release) {
+        if constexpr (left_hashed) {
+            _left_tree.for_each([&](auto *n) { release(static_cast<node_t *>(n)); });
+        } else {
+            auto *n = _dummy->left().left;
+            while (n != nullptr) {
+                if (auto *l = n->left; l != nullptr) {
+                    n->left = l->right;
+                    l->right = n;
+                    n = l;
+                } else {
+                    auto *next = n->right;
+                    release(static_cast<node_t *>(n));
+                    n = next;
+                }
+            }
+        }
     }
 
     alignas(node_t) char fake_arr[sizeof(node_t)]{};
     node_t *_dummy = (node_t *)fake_arr;
     left_tree _left_tree;
     right_tree _right_tree;
+    node_pool _pool;
 };
 
 template <typename Left, typename Right, typename CompareLeft,
-        typename CompareRight>
-typename bimap<Left, Right, CompareLeft, CompareRight>::left_iterator
-bimap<Left, Right, CompareLeft, CompareRight>::flip_to_left(right_iterator r) {
+        typename CompareRight, typename Allocator, typename... Policies>
+typename bimap<Left, Right, CompareLeft, CompareRight, Allocator,
+               Policies...>::left_iterator
+bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>::flip_to_left(
+        right_iterator r) {
     return bimap::left_iterator(
             typename left_tree::iterator(static_cast<node_t *>(r.node()),
                                          static_cast<node_t *>(r._iterator._end)));
 }
 template <typename Left, typename Right, typename CompareLeft,
-        typename CompareRight>
-typename bimap<Left, Right, CompareLeft, CompareRight>::right_iterator
-bimap<Left, Right, CompareLeft, CompareRight>::flip_to_right(left_iterator r) {
+        typename CompareRight, typename Allocator, typename... Policies>
+typename bimap<Left, Right, CompareLeft, CompareRight, Allocator,
+               Policies...>::right_iterator
+bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>::flip_to_right(
+        left_iterator r) {
     return bimap::right_iterator(
             typename right_tree::iterator(static_cast<node_t *>(r.node()),
                                           static_cast<node_t *>(r._iterator._end)));
 }
- 
\ No newline at end of file
+ 
+// bimap с хешированными обеими сторонами: поиск по left и по right за O(1)
+// в среднем, обход в порядке таблицы.
+template <typename Left, typename Right,
+        typename Allocator = std::allocator<std::pair<Left, Right>>>
+using unordered_bimap = bimap<Left, Right, hashed<>, hashed<>, Allocator>;
+
+
+namespace pmr {
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+        typename CompareRight = std::less<Right>, typename... Policies>
+using bimap = ::bimap<Left, Right, CompareLeft, CompareRight,
+        std::pmr::polymorphic_allocator<std::pair<Left, Right>>, Policies...>;
+
+template <typename Left, typename Right>
+using unordered_bimap =
+        ::unordered_bimap<Left, Right, std::pmr::polymorphic_allocator<std::pair<Left, Right>>>;
+} // namespace pmr
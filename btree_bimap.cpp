@@ -0,0 +1,1005 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Поиск в узле B-дерева: число ключей keys[0, n), меньших key или больших
+// key. Ключи сравниваются все сразу векторными инструкциями (AVX2 или SSE2,
+// смотря для чего собрана программа), результат -- битовая маска, из
+// которой берется число единиц. Ветвлений, зависящих от ключей, нет.
+// Для типов без векторного пути -- скалярный цикл без ветвлений.
+// Узлы выделены с запасом до целого числа векторов, поэтому чтение за
+// пределами n безопасно, лишние биты маски отбрасываются.
+template <class K> struct key_search {
+    static unsigned count_less(K const *keys, unsigned n, K key) {
+        return count<false>(keys, n, key);
+    }
+
+    static unsigned count_greater(K const *keys, unsigned n, K key) {
+        return count<true>(keys, n, key);
+    }
+
+private:
+    static unsigned popcount(unsigned mask) {
+#if defined(__GNUC__)
+        return static_cast<unsigned>(__builtin_popcount(mask));
+#else
+        unsigned c = 0;
+        for (; mask != 0; mask &= mask - 1) {
+            ++c;
+        }
+        return c;
+#endif
+    }
+
+    template <unsigned Lanes, class Block> static unsigned count_blocks(unsigned n, Block block) {
+        unsigned c = 0;
+        for (unsigned i = 0; i < n; i += Lanes) {
+            unsigned mask = block(i);
+            if (n - i < Lanes) {
+                mask &= (1u << (n - i)) - 1;
+            }
+            c += popcount(mask);
+        }
+        return c;
+    }
+
+    // Беззнаковые ключи сравниваются знаковыми инструкциями после
+    // инверсии старшего бита.
+    template <class S> static S biased(K key) {
+        if constexpr (std::is_unsigned_v<K>) {
+            return static_cast<S>(key ^ (K{1} << (sizeof(K) * 8 - 1)));
+        } else {
+            return static_cast<S>(key);
+        }
+    }
+
+    template <bool Greater> static unsigned count(K const *keys, unsigned n, K key) {
+        constexpr bool int32 = std::is_integral_v<K> && sizeof(K) == 4;
+        constexpr bool int64 = std::is_integral_v<K> && sizeof(K) == 8;
+        constexpr bool sign = std::is_unsigned_v<K>;
+#if defined(__AVX2__)
+        if constexpr (int32 || int64) {
+            __m256i bias = int32 ? _mm256_set1_epi32(sign ? INT32_MIN : 0)
+                                 : _mm256_set1_epi64x(sign ? INT64_MIN : 0);
+            __m256i k = int32 ? _mm256_set1_epi32(biased<std::int32_t>(key))
+                              : _mm256_set1_epi64x(biased<std::int64_t>(key));
+            return count_blocks<32 / sizeof(K)>(n, [&](unsigned i) {
+                __m256i x = _mm256_xor_si256(
+                        _mm256_loadu_si256(reinterpret_cast<__m256i const *>(keys + i)), bias);
+                __m256i a = Greater ? x : k;
+                __m256i b = Greater ? k : x;
+                if constexpr (int32) {
+                    return static_cast<unsigned>(
+                            _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))));
+                } else {
+                    return static_cast<unsigned>(
+                            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b))));
+                }
+            });
+        }
+        if constexpr (std::is_same_v<K, float>) {
+            __m256 k = _mm256_set1_ps(key);
+            return count_blocks<8>(n, [&](unsigned i) {
+                __m256 x = _mm256_loadu_ps(keys + i);
+                return static_cast<unsigned>(_mm256_movemask_ps(
+                        Greater ? _mm256_cmp_ps(x, k, _CMP_GT_OQ) : _mm256_cmp_ps(x, k, _CMP_LT_OQ)));
+            });
+        }
+        if constexpr (std::is_same_v<K, double>) {
+            __m256d k = _mm256_set1_pd(key);
+            return count_blocks<4>(n, [&](unsigned i) {
+                __m256d x = _mm256_loadu_pd(keys + i);
+                return static_cast<unsigned>(_mm256_movemask_pd(
+                        Greater ? _mm256_cmp_pd(x, k, _CMP_GT_OQ) : _mm256_cmp_pd(x, k, _CMP_LT_OQ)));
+            });
+        }
+#elif defined(__SSE2__)
+        if constexpr (int32) {
+            __m128i bias = _mm_set1_epi32(sign ? INT32_MIN : 0);
+            __m128i k = _mm_set1_epi32(biased<std::int32_t>(key));
+            return count_blocks<4>(n, [&](unsigned i) {
+                __m128i x = _mm_xor_si128(
+                        _mm_loadu_si128(reinterpret_cast<__m128i const *>(keys + i)), bias);
+                return static_cast<unsigned>(_mm_movemask_ps(
+                        _mm_castsi128_ps(Greater ? _mm_cmpgt_epi32(x, k) : _mm_cmpgt_epi32(k, x))));
+            });
+        }
+#if defined(__SSE4_2__)
+        if constexpr (int64) {
+            __m128i bias = _mm_set1_epi64x(sign ? INT64_MIN : 0);
+            __m128i k = _mm_set1_epi64x(biased<std::int64_t>(key));
+            return count_blocks<2>(n, [&](unsigned i) {
+                __m128i x = _mm_xor_si128(
+                        _mm_loadu_si128(reinterpret_cast<__m128i const *>(keys + i)), bias);
+                return static_cast<unsigned>(_mm_movemask_pd(
+                        _mm_castsi128_pd(Greater ? _mm_cmpgt_epi64(x, k) : _mm_cmpgt_epi64(k, x))));
+            });
+        }
+#endif
+        if constexpr (std::is_same_v<K, float>) {
+            __m128 k = _mm_set1_ps(key);
+            return count_blocks<4>(n, [&](unsigned i) {
+                __m128 x = _mm_loadu_ps(keys + i);
+                return static_cast<unsigned>(
+                        _mm_movemask_ps(Greater ? _mm_cmpgt_ps(x, k) : _mm_cmplt_ps(x, k)));
+            });
+        }
+        if constexpr (std::is_same_v<K, double>) {
+            __m128d k = _mm_set1_pd(key);
+            return count_blocks<2>(n, [&](unsigned i) {
+                __m128d x = _mm_loadu_pd(keys + i);
+                return static_cast<unsigned>(
+                        _mm_movemask_pd(Greater ? _mm_cmpgt_pd(x, k) : _mm_cmplt_pd(x, k)));
+            });
+        }
+#endif
+        (void)int32;
+        (void)int64;
+        (void)sign;
+        unsigned c = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            c += Greater ? key < keys[i] : keys[i] < key;
+        }
+        return c;
+    }
+};
+
+// bimap для арифметических Left и Right с порядком std::less: обе стороны --
+// B+-деревья с широкими узлами. Ключи узла лежат подряд и занимают четыре
+// кэш-линии подряд (256 байт, от 8 до 64 ключей), высота дерева ~log_32 n
+// вместо ~log_2 n у двоичного, а поиск в узле -- векторный, см.
+// key_search. Листья связаны в список, так что обход идет по массивам.
+// Запись листа -- ключ, парное значение и лист другой стороны, где лежит
+// пара. Значение позволяет at_* не ходить в другое дерево, а flip() --
+// это переход в парный лист и поиск в нем, O(1) при фиксированной ширине
+// узла. Когда записи переезжают в новый лист при расщеплении, их парные
+// записи перенаправляются на него.
+// Удаление не перебалансирует дерево: опустевший лист удаляется, и
+// внутренние узлы тоже удаляются, только опустев. Высота при этом не больше, чем у
+// дерева, в которое только вставляли, но после массового удаления листья
+// могут остаться полупустыми.
+// Любые insert и erase инвалидируют итераторы: записи сдвигаются в листе.
+template <typename Left, typename Right,
+          typename Allocator = std::allocator<std::pair<Left, Right>>>
+struct btree_bimap {
+    static_assert(std::is_arithmetic_v<Left> && std::is_arithmetic_v<Right>,
+                  "btree_bimap: Left и Right должны быть арифметическими");
+
+    using left_t = Left;
+    using right_t = Right;
+    using allocator_type = Allocator;
+
+private:
+    template <class K>
+    static constexpr unsigned capacity =
+            static_cast<unsigned>(std::clamp<size_t>(256 / sizeof(K), 8, 64));
+
+    template <class K> struct inner;
+
+    template <class K> struct node {
+        inner<K> *parent = nullptr;
+    };
+
+    // Разделитель keys[i] -- нижняя граница ключей children[i + 1].
+    template <class K> struct inner : node<K> {
+        unsigned count = 0;
+        K keys[capacity<K>]{};
+        node<K> *children[capacity<K> + 1]{};
+    };
+
+    template <class K, class V> struct leaf : node<K> {
+        leaf *prev = nullptr;
+        leaf *next = nullptr;
+        unsigned count = 0;
+        K keys[capacity<K>]{};
+        V values[capacity<K>]{};
+        leaf<V, K> *partners[capacity<K>]{};
+    };
+
+    template <class T>
+    using rebind = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    template <class T> static T *create(Allocator const &alloc) {
+        rebind<T> a(alloc);
+        T *p = std::allocator_traits<rebind<T>>::allocate(a, 1);
+        ::new (static_cast<void *>(p)) T();
+        return p;
+    }
+
+    template <class T> static void destroy(Allocator const &alloc, T *p) {
+        rebind<T> a(alloc);
+        std::allocator_traits<rebind<T>>::deallocate(a, p, 1);
+    }
+
+    // Одна сторона: B+-дерево по K, V -- тип другой стороны.
+    template <class K, class V> struct side {
+        using leaf_t = leaf<K, V>;
+        using inner_t = inner<K>;
+        using partner_t = leaf<V, K>;
+        using search = key_search<K>;
+        static constexpr unsigned cap = capacity<K>;
+
+        struct position {
+            leaf_t *leaf;
+            unsigned pos;
+            bool found;
+        };
+
+        // Лист, в диапазон которого попадает key; nullptr у пустого дерева.
+        leaf_t *leaf_for(K key) const {
+            node<K> *n = root;
+            for (unsigned level = height; level > 0; --level) {
+                auto *in = static_cast<inner_t *>(n);
+                n = in->children[in->count - search::count_greater(in->keys, in->count, key)];
+            }
+            return static_cast<leaf_t *>(n);
+        }
+
+        position locate(K key) const {
+            leaf_t *l = leaf_for(key);
+            if (l == nullptr) {
+                return {nullptr, 0, false};
+            }
+            unsigned i = search::count_less(l->keys, l->count, key);
+            return {l, i, i != l->count && !(key < l->keys[i])};
+        }
+
+        // Позиция ключа, который точно лежит в листе l.
+        static unsigned slot(leaf_t const *l, K key) {
+            return search::count_less(l->keys, l->count, key);
+        }
+
+        // Первая позиция с ключом не меньше key, {nullptr, 0} -- end.
+        position lower_bound(K key) const {
+            position p = locate(key);
+            if (p.leaf != nullptr && p.pos == p.leaf->count) {
+                return {p.leaf->next, 0, false};
+            }
+            return p;
+        }
+
+        // Внутренние узлы, выделенные для расщепления заранее. Узел,
+        // расщепляемый add_child, имеет не меньше cap / 2 детей, поэтому
+        // 64 уровней хватает на любое число ключей.
+        struct spare_nodes {
+            spare_nodes() = default;
+            spare_nodes(spare_nodes const &) = delete;
+            spare_nodes &operator=(spare_nodes const &) = delete;
+
+            void release(Allocator const &alloc) {
+                while (count != 0) {
+                    destroy(alloc, take());
+                }
+            }
+
+            inner_t *take() { return nodes[--count]; }
+
+            inner_t *nodes[64];
+            unsigned count = 0;
+        };
+
+        // Готовит место под ключ в позиции p: создает корень пустого
+        // дерева или расщепляет полный лист. Записи, переехавшие в новый
+        // лист, перенаправляются в other.
+        // Все узлы расщепления, вплоть до нового корня, выделяются до
+        // изменения дерева: если аллокатор бросит, дерево не меняется.
+        void make_room(position &p, side<V, K> &other, Allocator const &alloc) {
+            if (p.leaf == nullptr) {
+                p.leaf = first = last = create<leaf_t>(alloc);
+                root = p.leaf;
+                return;
+            }
+            if (p.leaf->count < cap) {
+                return;
+            }
+            leaf_t *l = p.leaf;
+            spare_nodes spare;
+            leaf_t *r = create<leaf_t>(alloc);
+            try {
+                inner_t *a = l->parent;
+                while (a != nullptr && a->count + 1 == cap) {
+                    a = a->parent;
+                    spare.nodes[spare.count++] = create<inner_t>(alloc);
+                }
+                if (a == nullptr) {
+                    spare.nodes[spare.count++] = create<inner_t>(alloc);
+                }
+            } catch (...) {
+                spare.release(alloc);
+                destroy(alloc, r);
+                throw;
+            }
+            unsigned const half = cap / 2;
+            for (unsigned i = half; i < cap; ++i) {
+                r->keys[i - half] = l->keys[i];
+                r->values[i - half] = l->values[i];
+                partner_t *partner = l->partners[i];
+                r->partners[i - half] = partner;
+                partner->partners[other.slot(partner, l->values[i])] = r;
+            }
+            r->count = cap - half;
+            l->count = half;
+            r->prev = l;
+            r->next = l->next;
+            (l->next != nullptr ? l->next->prev : last) = r;
+            l->next = r;
+            // Ключ на границе остается в конце l: он меньше r->keys[0],
+            // нового разделителя.
+            if (p.pos > half) {
+                p.leaf = r;
+                p.pos -= half;
+            }
+            add_child(l, r->keys[0], r, spare);
+        }
+
+        // Вставляет separator и right_child справа от left_child в его
+        // родителя, расщепляя переполненные узлы вверх. Новые узлы берутся
+        // из spare, так что исключений нет.
+        void add_child(node<K> *left_child, K separator, node<K> *right_child,
+                       spare_nodes &spare) {
+            inner_t *parent = left_child->parent;
+            if (parent == nullptr) {
+                parent = spare.take();
+                parent->count = 1;
+                parent->keys[0] = separator;
+                parent->children[0] = left_child;
+                parent->children[1] = right_child;
+                left_child->parent = right_child->parent = parent;
+                root = parent;
+                ++height;
+                return;
+            }
+            unsigned c = child_index(parent, left_child);
+            for (unsigned i = parent->count; i > c; --i) {
+                parent->keys[i] = parent->keys[i - 1];
+                parent->children[i + 1] = parent->children[i];
+            }
+            parent->keys[c] = separator;
+            parent->children[c + 1] = right_child;
+            right_child->parent = parent;
+            if (++parent->count < cap) {
+                return;
+            }
+            inner_t *sibling = spare.take();
+            unsigned const mid = cap / 2;
+            for (unsigned i = mid + 1; i < cap; ++i) {
+                sibling->keys[i - mid - 1] = parent->keys[i];
+            }
+            for (unsigned i = mid + 1; i <= cap; ++i) {
+                sibling->children[i - mid - 1] = parent->children[i];
+                parent->children[i]->parent = sibling;
+                parent->children[i] = nullptr;
+            }
+            sibling->count = cap - mid - 1;
+            parent->count = mid;
+            add_child(parent, parent->keys[mid], sibling, spare);
+        }
+
+        static unsigned child_index(inner_t const *parent, node<K> const *child) {
+            unsigned c = 0;
+            while (parent->children[c] != child) {
+                ++c;
+            }
+            return c;
+        }
+
+        void insert_at(position p, K key, V value, partner_t *partner) {
+            leaf_t *l = p.leaf;
+            for (unsigned i = l->count; i > p.pos; --i) {
+                l->keys[i] = l->keys[i - 1];
+                l->values[i] = l->values[i - 1];
+                l->partners[i] = l->partners[i - 1];
+            }
+            l->keys[p.pos] = key;
+            l->values[p.pos] = value;
+            l->partners[p.pos] = partner;
+            ++l->count;
+        }
+
+        void erase_at(leaf_t *l, unsigned pos, Allocator const &alloc) {
+            --l->count;
+            for (unsigned i = pos; i < l->count; ++i) {
+                l->keys[i] = l->keys[i + 1];
+                l->values[i] = l->values[i + 1];
+                l->partners[i] = l->partners[i + 1];
+            }
+            if (l->count != 0) {
+                return;
+            }
+            (l->prev != nullptr ? l->prev->next : first) = l->next;
+            (l->next != nullptr ? l->next->prev : last) = l->prev;
+            remove_child(l, alloc);
+            destroy(alloc, l);
+        }
+
+        // Убирает пустой узел n из родителя. Родитель без детей убирается
+        // следом, корень с единственным ребенком заменяется этим ребенком.
+        void remove_child(node<K> *n, Allocator const &alloc) {
+            inner_t *parent = n->parent;
+            if (parent == nullptr) {
+                root = nullptr;
+                height = 0;
+                return;
+            }
+            unsigned c = child_index(parent, n);
+            if (parent->count == 0) {
+                remove_child(parent, alloc);
+                destroy(alloc, parent);
+                return;
+            }
+            for (unsigned i = c == 0 ? 0 : c - 1; i + 1 < parent->count; ++i) {
+                parent->keys[i] = parent->keys[i + 1];
+            }
+            for (unsigned i = c; i < parent->count; ++i) {
+                parent->children[i] = parent->children[i + 1];
+            }
+            parent->children[parent->count] = nullptr;
+            --parent->count;
+            while (height > 0 && static_cast<inner_t *>(root)->count == 0) {
+                auto *old = static_cast<inner_t *>(root);
+                root = old->children[0];
+                root->parent = nullptr;
+                --height;
+                destroy(alloc, old);
+            }
+        }
+
+        void clear(Allocator const &alloc) {
+            free_subtree(root, height, alloc);
+            root = nullptr;
+            first = last = nullptr;
+            height = 0;
+        }
+
+        static void free_subtree(node<K> *n, unsigned level, Allocator const &alloc) {
+            if (n == nullptr) {
+                return;
+            }
+            if (level == 0) {
+                destroy(alloc, static_cast<leaf_t *>(n));
+                return;
+            }
+            auto *in = static_cast<inner_t *>(n);
+            for (node<K> *child : in->children) {
+                free_subtree(child, level - 1, alloc);
+            }
+            destroy(alloc, in);
+        }
+
+        // Копирует дерево other той же формы; в copies -- пары (лист other,
+        // его копия). Узел подвешивается к родителю сразу после создания,
+        // так что при исключении недостроенное дерево освобождается через
+        // clear.
+        void clone(side const &other, std::vector<std::pair<leaf_t const *, leaf_t *>> &copies,
+                   Allocator const &alloc) {
+            height = other.height;
+            if (other.root != nullptr) {
+                clone_subtree(other.root, other.height, nullptr, root, copies, alloc);
+            }
+        }
+
+        void clone_subtree(node<K> const *n, unsigned level, inner_t *parent, node<K> *&out,
+                           std::vector<std::pair<leaf_t const *, leaf_t *>> &copies,
+                           Allocator const &alloc) {
+            if (level == 0) {
+                auto const *from = static_cast<leaf_t const *>(n);
+                leaf_t *copy = create<leaf_t>(alloc);
+                out = copy;
+                copy->parent = parent;
+                copy->count = from->count;
+                std::copy(from->keys, from->keys + from->count, copy->keys);
+                std::copy(from->values, from->values + from->count, copy->values);
+                copy->prev = last;
+                (last != nullptr ? last->next : first) = copy;
+                last = copy;
+                copies.emplace_back(from, copy);
+                return;
+            }
+            auto const *from = static_cast<inner_t const *>(n);
+            inner_t *copy = create<inner_t>(alloc);
+            out = copy;
+            copy->parent = parent;
+            copy->count = from->count;
+            std::copy(from->keys, from->keys + from->count, copy->keys);
+            for (unsigned i = 0; i <= from->count; ++i) {
+                clone_subtree(from->children[i], level - 1, copy, copy->children[i], copies,
+                              alloc);
+            }
+        }
+
+        node<K> *root = nullptr;
+        // Число уровней внутренних узлов над листьями.
+        unsigned height = 0;
+        leaf_t *first = nullptr;
+        leaf_t *last = nullptr;
+    };
+
+    using left_side = side<Left, Right>;
+    using right_side = side<Right, Left>;
+    using left_leaf = typename left_side::leaf_t;
+    using right_leaf = typename right_side::leaf_t;
+
+public:
+    struct right_iterator;
+
+    struct left_iterator {
+        left_iterator(btree_bimap const *map, left_leaf *leaf, unsigned pos)
+                : _map(map), _leaf(leaf), _pos(pos) {}
+
+        // Разыменование end_left() и невалидного итератора неопределено.
+        left_t const &operator*() const { return _leaf->keys[_pos]; }
+
+        left_iterator &operator++() {
+            if (++_pos == _leaf->count) {
+                _leaf = _leaf->next;
+                _pos = 0;
+            }
+            return *this;
+        }
+
+        left_iterator operator++(int) {
+            left_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        // Декремент end_left() дает наибольший left.
+        left_iterator &operator--() {
+            if (_leaf == nullptr || _pos == 0) {
+                _leaf = _leaf == nullptr ? _map->_left.last : _leaf->prev;
+                _pos = _leaf->count;
+            }
+            --_pos;
+            return *this;
+        }
+
+        left_iterator operator--(int) {
+            left_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        // Итератор на right той же пары, end_left().flip() -- end_right().
+        right_iterator flip() const {
+            if (_leaf == nullptr) {
+                return _map->end_right();
+            }
+            right_leaf *partner = _leaf->partners[_pos];
+            return right_iterator{_map, partner,
+                                  right_side::slot(partner, _leaf->values[_pos])};
+        }
+
+        [[nodiscard]] bool operator==(left_iterator it) const {
+            return _leaf == it._leaf && _pos == it._pos;
+        }
+        [[nodiscard]] bool operator!=(left_iterator it) const { return !(*this == it); }
+
+        btree_bimap const *_map;
+        left_leaf *_leaf;
+        unsigned _pos;
+    };
+
+    struct right_iterator {
+        right_iterator(btree_bimap const *map, right_leaf *leaf, unsigned pos)
+                : _map(map), _leaf(leaf), _pos(pos) {}
+
+        right_t const &operator*() const { return _leaf->keys[_pos]; }
+
+        right_iterator &operator++() {
+            if (++_pos == _leaf->count) {
+                _leaf = _leaf->next;
+                _pos = 0;
+            }
+            return *this;
+        }
+
+        right_iterator operator++(int) {
+            right_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        right_iterator &operator--() {
+            if (_leaf == nullptr || _pos == 0) {
+                _leaf = _leaf == nullptr ? _map->_right.last : _leaf->prev;
+                _pos = _leaf->count;
+            }
+            --_pos;
+            return *this;
+        }
+
+        right_iterator operator--(int) {
+            right_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        left_iterator flip() const {
+            if (_leaf == nullptr) {
+                return _map->end_left();
+            }
+            left_leaf *partner = _leaf->partners[_pos];
+            return left_iterator{_map, partner, left_side::slot(partner, _leaf->values[_pos])};
+        }
+
+        [[nodiscard]] bool operator==(right_iterator it) const {
+            return _leaf == it._leaf && _pos == it._pos;
+        }
+        [[nodiscard]] bool operator!=(right_iterator it) const { return !(*this == it); }
+
+        btree_bimap const *_map;
+        right_leaf *_leaf;
+        unsigned _pos;
+    };
+
+    btree_bimap() = default;
+
+    explicit btree_bimap(Allocator const &alloc) : _alloc(alloc) {}
+
+    // Создает btree_bimap из диапазона пар, см. insert_range.
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    btree_bimap(InputIt first, InputIt last, Allocator const &alloc = Allocator())
+            : btree_bimap(alloc) {
+        insert_range(first, last);
+    }
+
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    btree_bimap(sorted_left_t, InputIt first, InputIt last, Allocator const &alloc = Allocator())
+            : btree_bimap(alloc) {
+        insert_range(sorted_left, first, last);
+    }
+
+    // Копирование линейно: деревья копируются узел в узел, ссылки на
+    // парные листья переводятся через хеш-таблицу "лист other -> копия"
+    // (см. leaf_index).
+    btree_bimap(btree_bimap const &other)
+            : btree_bimap(other, std::allocator_traits<Allocator>::
+                                         select_on_container_copy_construction(other._alloc)) {}
+
+    btree_bimap(btree_bimap const &other, Allocator const &alloc) : btree_bimap(alloc) {
+        std::vector<std::pair<left_leaf const *, left_leaf *>> lefts;
+        std::vector<std::pair<right_leaf const *, right_leaf *>> rights;
+        _left.clone(other._left, lefts, _alloc);
+        _right.clone(other._right, rights, _alloc);
+        link_partners(lefts, leaf_index<right_leaf>(rights));
+        link_partners(rights, leaf_index<left_leaf>(lefts));
+        _size = other._size;
+    }
+
+    btree_bimap(btree_bimap &&other) noexcept : btree_bimap(other._alloc) { swap(other); }
+
+    // Строгая гарантия: если копирование бросит исключение, *this не
+    // изменится. Аллокатор other переходит к *this, только если это
+    // разрешает propagate_on_container_copy_assignment.
+    btree_bimap &operator=(btree_bimap const &other) {
+        if (this != &other) {
+            btree_bimap copy(other, propagate_on_copy::value ? other._alloc : _alloc);
+            take(copy, propagate_on_copy{});
+        }
+        return *this;
+    }
+
+    // Если аллокатор не переносится и аллокаторы различны, узлы other не
+    // могут перейти к *this, и пары копируются.
+    btree_bimap &operator=(btree_bimap &&other) noexcept(
+            propagate_on_move::value ||
+            std::allocator_traits<Allocator>::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        if constexpr (!propagate_on_move::value) {
+            if (_alloc != other._alloc) {
+                return *this = static_cast<btree_bimap const &>(other);
+            }
+        }
+        btree_bimap moved(std::move(other));
+        take(moved, propagate_on_move{});
+        return *this;
+    }
+
+    ~btree_bimap() {
+        _left.clear(_alloc);
+        _right.clear(_alloc);
+    }
+
+    // Аллокаторы должны быть равны, если propagate_on_container_swap
+    // ложно (как у pmr): иначе узлы одного ресурса освобождались бы через
+    // другой.
+    void swap(btree_bimap &other) noexcept {
+        if constexpr (std::allocator_traits<Allocator>::propagate_on_container_swap::value) {
+            using std::swap;
+            swap(_alloc, other._alloc);
+        }
+        swap_contents(other);
+    }
+
+    friend void swap(btree_bimap &a, btree_bimap &b) noexcept { a.swap(b); }
+
+    // Вставка пары (left, right), возвращает итератор на left.
+    // Если такой left или такой right уже присутствуют, вставка не
+    // производится и возвращается end_left().
+    // Сначала в обоих листах освобождается место (расщепление может
+    // перенаправить записи другой стороны), потом пара записывается в оба.
+    // Если аллокатор бросит, пары остаются прежними.
+    left_iterator insert(left_t left, right_t right) {
+        auto left_pos = _left.locate(left);
+        if (left_pos.found) {
+            return end_left();
+        }
+        auto right_pos = _right.locate(right);
+        if (right_pos.found) {
+            return end_left();
+        }
+        _left.make_room(left_pos, _right, _alloc);
+        try {
+            _right.make_room(right_pos, _left, _alloc);
+        } catch (...) {
+            // Пустой корневой лист, созданный для первой пары, не должен
+            // остаться: обход принял бы его за непустой.
+            if (_size == 0) {
+                _left.clear(_alloc);
+            }
+            throw;
+        }
+        _left.insert_at(left_pos, left, right, right_pos.leaf);
+        _right.insert_at(right_pos, right, left, left_pos.leaf);
+        ++_size;
+        return left_iterator{this, left_pos.leaf, left_pos.pos};
+    }
+
+    // Вставка диапазона пар по одной, с тем же результатом, что у
+    // bimap::insert_range: пара пропускается, если ее left или right уже
+    // есть. Каждая вставка -- спуск по обоим деревьям, поэтому порядок
+    // диапазона по left (sorted_left) только делает спуски по левому
+    // дереву дешевле за счет кэша.
+    template <class InputIt> void insert_range(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            auto &&pair = *first;
+            insert(std::get<0>(pair), std::get<1>(pair));
+        }
+    }
+
+    template <class InputIt> void insert_range(sorted_left_t, InputIt first, InputIt last) {
+        insert_range(first, last);
+    }
+
+    // Удаляет пару, возвращает итератор на следующий элемент той же стороны.
+    // erase(end_left()) и erase невалидного итератора неопределены.
+    left_iterator erase_left(left_iterator it) {
+        left_leaf *l = it._leaf;
+        left_leaf *next = l->next;
+        bool last = it._pos + 1 == l->count;
+        right_leaf *partner = l->partners[it._pos];
+        _right.erase_at(partner, right_side::slot(partner, l->values[it._pos]), _alloc);
+        _left.erase_at(l, it._pos, _alloc);
+        --_size;
+        return last ? left_iterator{this, next, 0} : it;
+    }
+
+    bool erase_left(left_t left) {
+        auto pos = _left.locate(left);
+        if (!pos.found) {
+            return false;
+        }
+        erase_left(left_iterator{this, pos.leaf, pos.pos});
+        return true;
+    }
+
+    right_iterator erase_right(right_iterator it) {
+        right_leaf *r = it._leaf;
+        right_leaf *next = r->next;
+        bool last = it._pos + 1 == r->count;
+        left_leaf *partner = r->partners[it._pos];
+        _left.erase_at(partner, left_side::slot(partner, r->values[it._pos]), _alloc);
+        _right.erase_at(r, it._pos, _alloc);
+        --_size;
+        return last ? right_iterator{this, next, 0} : it;
+    }
+
+    bool erase_right(right_t right) {
+        auto pos = _right.locate(right);
+        if (!pos.found) {
+            return false;
+        }
+        erase_right(right_iterator{this, pos.leaf, pos.pos});
+        return true;
+    }
+
+    left_iterator find_left(left_t left) const {
+        auto pos = _left.locate(left);
+        return pos.found ? left_iterator{this, pos.leaf, pos.pos} : end_left();
+    }
+
+    right_iterator find_right(right_t right) const {
+        auto pos = _right.locate(right);
+        return pos.found ? right_iterator{this, pos.leaf, pos.pos} : end_right();
+    }
+
+    // Если элемента не существует -- бросает std::out_of_range
+    right_t const &at_left(left_t key) const {
+        auto pos = _left.locate(key);
+        if (!pos.found) {
+            throw std::out_of_range{"at_left: not found"};
+        }
+        return pos.leaf->values[pos.pos];
+    }
+
+    left_t const &at_right(right_t key) const {
+        auto pos = _right.locate(key);
+        if (!pos.found) {
+            throw std::out_of_range{"at_right: not found"};
+        }
+        return pos.leaf->values[pos.pos];
+    }
+
+    left_iterator lower_bound_left(left_t left) const {
+        auto pos = _left.lower_bound(left);
+        return left_iterator{this, pos.leaf, pos.pos};
+    }
+
+    left_iterator upper_bound_left(left_t left) const {
+        auto pos = _left.lower_bound(left);
+        left_iterator it{this, pos.leaf, pos.pos};
+        return pos.found ? ++it : it;
+    }
+
+    right_iterator lower_bound_right(right_t right) const {
+        auto pos = _right.lower_bound(right);
+        return right_iterator{this, pos.leaf, pos.pos};
+    }
+
+    right_iterator upper_bound_right(right_t right) const {
+        auto pos = _right.lower_bound(right);
+        right_iterator it{this, pos.leaf, pos.pos};
+        return pos.found ? ++it : it;
+    }
+
+    left_iterator begin_left() const { return left_iterator{this, _left.first, 0}; }
+    left_iterator end_left() const { return left_iterator{this, nullptr, 0}; }
+
+    right_iterator begin_right() const { return right_iterator{this, _right.first, 0}; }
+    right_iterator end_right() const { return right_iterator{this, nullptr, 0}; }
+
+    allocator_type get_allocator() const { return _alloc; }
+
+    bool empty() const { return _size == 0; }
+
+    std::size_t size() const { return _size; }
+
+    friend bool operator==(btree_bimap const &a, btree_bimap const &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (auto it = a.begin_left(), other = b.begin_left(); it != a.end_left();
+             ++it, ++other) {
+            if (*it != *other || it._leaf->values[it._pos] != other._leaf->values[other._pos]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(btree_bimap const &a, btree_bimap const &b) { return !(a == b); }
+
+private:
+    using propagate_on_copy =
+            typename std::allocator_traits<Allocator>::propagate_on_container_copy_assignment;
+    using propagate_on_move =
+            typename std::allocator_traits<Allocator>::propagate_on_container_move_assignment;
+
+    // Обмен всем, кроме аллокатора.
+    void swap_contents(btree_bimap &other) noexcept {
+        using std::swap;
+        swap(_left, other._left);
+        swap(_right, other._right);
+        swap(_size, other._size);
+    }
+
+    // Забирает содержимое source, узлы которого выделены аллокатором,
+    // равным _alloc, или аллокатором, который переходит к *this вместе с
+    // ними (Propagate). Прежнее содержимое освобождает source.
+    template <bool Propagate> void take(btree_bimap &source, std::bool_constant<Propagate>) {
+        if constexpr (Propagate) {
+            using std::swap;
+            swap(_alloc, source._alloc);
+        }
+        swap_contents(source);
+    }
+
+    // Таблица "лист оригинала -> копия" с открытой адресацией по адресу
+    // оригинала, как bimap::copy_index: поиск за O(1).
+    template <class Leaf> struct leaf_index {
+        explicit leaf_index(std::vector<std::pair<Leaf const *, Leaf *>> const &copies) {
+            while ((size_t{1} << _bits) < 2 * copies.size()) {
+                ++_bits;
+            }
+            _slots.assign(size_t{1} << _bits, {nullptr, nullptr});
+            for (auto const &entry : copies) {
+                size_t i = slot(entry.first);
+                while (_slots[i].first != nullptr) {
+                    i = (i + 1) & (_slots.size() - 1);
+                }
+                _slots[i] = entry;
+            }
+        }
+
+        Leaf *find(Leaf const *original) const {
+            size_t i = slot(original);
+            while (_slots[i].first != original) {
+                i = (i + 1) & (_slots.size() - 1);
+            }
+            return _slots[i].second;
+        }
+
+    private:
+        size_t slot(Leaf const *original) const {
+            auto key = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(original));
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - _bits));
+        }
+
+        unsigned _bits = 1;
+        std::vector<std::pair<Leaf const *, Leaf *>> _slots;
+    };
+
+    // Заполняет ссылки на парные листья в копиях листов одной стороны по
+    // ссылкам оригиналов и таблице копий другой стороны: O(n) на сторону.
+    template <class Copies, class PartnerIndex>
+    static void link_partners(Copies const &copies, PartnerIndex const &partners) {
+        for (auto const &[from, copy] : copies) {
+            for (unsigned i = 0; i < from->count; ++i) {
+                copy->partners[i] = partners.find(from->partners[i]);
+            }
+        }
+    }
+
+    Allocator _alloc;
+    left_side _left;
+    right_side _right;
+    std::size_t _size = 0;
+};
+
+// Выбор реализации по типам: для арифметических Left и Right с порядком
+// std::less -- btree_bimap, иначе bimap.
+// bimap_for<std::uint64_t, std::uint32_t> -- btree_bimap<std::uint64_t, std::uint32_t>.
+// Интерфейс btree_bimap уже, чем у bimap: в нем есть insert, insert_range,
+// erase_* по ключу и итератору, find_*, at_*, lower/upper_bound_*, обход и
+// сравнение, но нет erase_* диапазона, at_*_or_default, emplace, node
+// handle и merge, прозрачного поиска, политик и порядковых статистик.
+// Код, которому они нужны, должен называть bimap явно.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>>
+struct bimap_selector {
+    using type = bimap<Left, Right, CompareLeft, CompareRight, Allocator>;
+};
+
+template <typename Left, typename Right, typename Allocator>
+struct bimap_selector<Left, Right, std::less<Left>, std::less<Right>, Allocator> {
+    using type = std::conditional_t<std::is_arithmetic_v<Left> && std::is_arithmetic_v<Right>,
+                                    btree_bimap<Left, Right, Allocator>,
+                                    bimap<Left, Right, std::less<Left>, std::less<Right>,
+                                          Allocator>>;
+};
+
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>>
+using bimap_for =
+        typename bimap_selector<Left, Right, CompareLeft, CompareRight, Allocator>::type;
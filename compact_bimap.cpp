@@ -0,0 +1,747 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Компактный bimap для очень больших объемов. Узлы адресуются 32-битными
+// индексами, а не указателями, и parent не хранится: на пару приходится
+// sizeof(Left) + sizeof(Right) + 16 байт связей против 48 байт у bimap.
+// Каждая сторона -- декартово дерево (treap), приоритет узла -- перемешанный
+// индекс, поэтому служебных полей в узле тоже нет, а вставка и удаление
+// идут одним спуском сверху вниз. Стороны лежат в отдельных массивах, так
+// что спуск по одной стороне не тянет в кэш значения другой.
+// Цена: высота O(log n) только в среднем, а переход итератора к соседнему
+// элементу без parent -- спуск от корня за O(log n).
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>>
+struct compact_bimap {
+    using left_t = Left;
+    using right_t = Right;
+    using allocator_type = Allocator;
+    using index = std::uint32_t;
+
+    // Отсутствующий ребенок, пустое дерево и end().
+    static constexpr index nil = UINT32_MAX;
+
+private:
+    // Пары выделяются кусками по chunk_size; индекс пары -- номер куска и
+    // место в нем, поэтому куски не перемещаются и не копируются при росте.
+    static constexpr unsigned chunk_bits = 12;
+    static constexpr index chunk_size = index{1} << chunk_bits;
+
+    // Значение одной стороны пары и дети в дереве этой стороны. Пока слот
+    // свободен, значения в нем нет, left слота левой стороны хранит
+    // следующий свободный индекс, а right -- собственный индекс слота:
+    // ребенком самого себя узел быть не может, так что это отметка
+    // свободного слота, и обход занятых слотов не требует памяти.
+    template <class T> struct slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        index left;
+        index right;
+
+        T &value() { return *std::launder(reinterpret_cast<T *>(storage)); }
+        T const &value() const {
+            return *std::launder(reinterpret_cast<T const *>(storage));
+        }
+    };
+
+    template <class T>
+    using rebind = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    // Перемешивание индекса (финализатор MurmurHash3). Это биекция, поэтому
+    // приоритеты различных узлов различны.
+    static index priority(index i) {
+        i ^= i >> 16;
+        i *= 0x85ebca6bu;
+        i ^= i >> 13;
+        i *= 0xc2b2ae35u;
+        i ^= i >> 16;
+        return i;
+    }
+
+    // Одна сторона: куски слотов и treap по ним.
+    template <class T, class Compare> struct side {
+        using slot_t = slot<T>;
+
+        side(Compare compare, Allocator const &alloc)
+                : chunks(rebind<slot_t *>(alloc)), comparator(compare) {}
+
+        slot_t &operator[](index i) {
+            return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+        }
+        slot_t const &operator[](index i) const {
+            return chunks[i >> chunk_bits][i & (chunk_size - 1)];
+        }
+
+        T const &value(index i) const { return (*this)[i].value(); }
+
+        template <class K> index lower_bound(K const &key) const {
+            index result = nil;
+            for (index t = root; t != nil;) {
+                if (comparator(value(t), key)) {
+                    t = (*this)[t].right;
+                } else {
+                    result = t;
+                    t = (*this)[t].left;
+                }
+            }
+            return result;
+        }
+
+        template <class K> index upper_bound(K const &key) const {
+            index result = nil;
+            for (index t = root; t != nil;) {
+                if (comparator(key, value(t))) {
+                    result = t;
+                    t = (*this)[t].left;
+                } else {
+                    t = (*this)[t].right;
+                }
+            }
+            return result;
+        }
+
+        template <class K> index find(K const &key) const {
+            index t = lower_bound(key);
+            return t != nil && !comparator(key, value(t)) ? t : nil;
+        }
+
+        // Наибольший элемент, меньший value(i), или nil.
+        index predecessor(index i) const {
+            index result = nil;
+            for (index t = root; t != nil;) {
+                if (comparator(value(t), value(i))) {
+                    result = t;
+                    t = (*this)[t].right;
+                } else {
+                    t = (*this)[t].left;
+                }
+            }
+            return result;
+        }
+
+        index first() const {
+            index t = root;
+            while (t != nil && (*this)[t].left != nil) {
+                t = (*this)[t].left;
+            }
+            return t;
+        }
+
+        index last() const {
+            index t = root;
+            while (t != nil && (*this)[t].right != nil) {
+                t = (*this)[t].right;
+            }
+            return t;
+        }
+
+        // Вставка x, значения которого в дереве нет: спуск до первого узла
+        // с меньшим приоритетом и разрезание его поддерева по value(x).
+        // Возвращает связь, указывающую на x (для unlink). Если компаратор
+        // бросит посреди разрезания, части склеиваются обратно и дерево
+        // остается прежним, без x.
+        index *insert(index x) {
+            index const p = priority(x);
+            index *link = &root;
+            while (*link != nil && priority(*link) > p) {
+                link = comparator(value(x), value(*link)) ? &(*this)[*link].left
+                                                          : &(*this)[*link].right;
+            }
+            index *less = &(*this)[x].left;
+            index *greater = &(*this)[x].right;
+            index t = *link;
+            try {
+                while (t != nil) {
+                    if (comparator(value(t), value(x))) {
+                        *less = t;
+                        less = &(*this)[t].right;
+                        t = *less;
+                    } else {
+                        *greater = t;
+                        greater = &(*this)[t].left;
+                        t = *greater;
+                    }
+                }
+            } catch (...) {
+                // Узлы цепочек less и greater шли по пути в порядке убывания
+                // приоритета, а неразрезанный остаток t ниже их всех, так что
+                // слияние по приоритетам восстанавливает поддерево.
+                *less = t;
+                *greater = nil;
+                merge(link, (*this)[x].left, (*this)[x].right);
+                throw;
+            }
+            *less = *greater = nil;
+            *link = x;
+            return link;
+        }
+
+        // Связь, указывающая на x, который есть в дереве.
+        index *link_to(index x) {
+            index *link = &root;
+            while (*link != x) {
+                link = comparator(value(x), value(*link)) ? &(*this)[*link].left
+                                                          : &(*this)[*link].right;
+            }
+            return link;
+        }
+
+        // Удаление узла, на который указывает link: его место занимает
+        // слияние его поддеревьев. Компаратор не вызывается.
+        void unlink(index *link) noexcept {
+            index const x = *link;
+            merge(link, (*this)[x].left, (*this)[x].right);
+        }
+
+        // Слияние treap a и b, все значения a меньше значений b, в *link.
+        void merge(index *link, index a, index b) noexcept {
+            while (a != nil && b != nil) {
+                if (priority(a) > priority(b)) {
+                    *link = a;
+                    link = &(*this)[a].right;
+                    a = *link;
+                } else {
+                    *link = b;
+                    link = &(*this)[b].left;
+                    b = *link;
+                }
+            }
+            *link = a != nil ? a : b;
+        }
+
+        std::vector<slot_t *, rebind<slot_t *>> chunks;
+        index root = nil;
+        Compare comparator;
+    };
+
+    using left_side = side<Left, CompareLeft>;
+    using right_side = side<Right, CompareRight>;
+
+public:
+    struct right_iterator;
+
+    struct left_iterator {
+        left_iterator(compact_bimap const *map, index id) : _map(map), _id(id) {}
+
+        // Разыменование end_left() и невалидного итератора неопределено.
+        left_t const &operator*() const { return _map->_left.value(_id); }
+
+        // Переход к следующему по величине left'у спуском от корня.
+        left_iterator &operator++() {
+            _id = _map->_left.upper_bound(_map->_left.value(_id));
+            return *this;
+        }
+
+        left_iterator operator++(int) {
+            left_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        // Декремент end_left() дает наибольший left.
+        left_iterator &operator--() {
+            _id = _id == nil ? _map->_left.last() : _map->_left.predecessor(_id);
+            return *this;
+        }
+
+        left_iterator operator--(int) {
+            left_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        // Итератор на right той же пары, end_left().flip() -- end_right().
+        right_iterator flip() const { return right_iterator{_map, _id}; }
+
+        [[nodiscard]] bool operator==(left_iterator it) const { return _id == it._id; }
+        [[nodiscard]] bool operator!=(left_iterator it) const { return !(*this == it); }
+
+        compact_bimap const *_map;
+        index _id;
+    };
+
+    struct right_iterator {
+        right_iterator(compact_bimap const *map, index id) : _map(map), _id(id) {}
+
+        right_t const &operator*() const { return _map->_right.value(_id); }
+
+        right_iterator &operator++() {
+            _id = _map->_right.upper_bound(_map->_right.value(_id));
+            return *this;
+        }
+
+        right_iterator operator++(int) {
+            right_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        right_iterator &operator--() {
+            _id = _id == nil ? _map->_right.last() : _map->_right.predecessor(_id);
+            return *this;
+        }
+
+        right_iterator operator--(int) {
+            right_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        left_iterator flip() const { return left_iterator{_map, _id}; }
+
+        [[nodiscard]] bool operator==(right_iterator it) const { return _id == it._id; }
+        [[nodiscard]] bool operator!=(right_iterator it) const { return !(*this == it); }
+
+        compact_bimap const *_map;
+        index _id;
+    };
+
+    compact_bimap(CompareLeft compare_left = CompareLeft(),
+                  CompareRight compare_right = CompareRight(),
+                  Allocator const &alloc = Allocator())
+            : _left(compare_left, alloc), _right(compare_right, alloc), _alloc(alloc) {}
+
+    explicit compact_bimap(Allocator const &alloc)
+            : compact_bimap(CompareLeft(), CompareRight(), alloc) {}
+
+    // Создает compact_bimap из диапазона пар, см. insert_range.
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    compact_bimap(InputIt first, InputIt last, CompareLeft compare_left = CompareLeft(),
+                  CompareRight compare_right = CompareRight(),
+                  Allocator const &alloc = Allocator())
+            : compact_bimap(compare_left, compare_right, alloc) {
+        insert_range(first, last);
+    }
+
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    compact_bimap(sorted_left_t, InputIt first, InputIt last,
+                  CompareLeft compare_left = CompareLeft(),
+                  CompareRight compare_right = CompareRight(),
+                  Allocator const &alloc = Allocator())
+            : compact_bimap(compare_left, compare_right, alloc) {
+        insert_range(sorted_left, first, last);
+    }
+
+    // Копирование линейно и без вызовов компараторов: слоты копируются по
+    // индексам вместе со связями, так что деревья копии совпадают с
+    // деревьями other.
+    compact_bimap(compact_bimap const &other)
+            : compact_bimap(other, std::allocator_traits<Allocator>::
+                                           select_on_container_copy_construction(other._alloc)) {}
+
+    compact_bimap(compact_bimap const &other, Allocator const &alloc)
+            : compact_bimap(other._left.comparator, other._right.comparator, alloc) {
+        copy_slots(other);
+    }
+
+    compact_bimap(compact_bimap &&other) noexcept(
+            std::is_nothrow_copy_constructible_v<CompareLeft> &&
+            std::is_nothrow_copy_constructible_v<CompareRight>)
+            : compact_bimap(other._left.comparator, other._right.comparator, other._alloc) {
+        swap(other);
+    }
+
+    // Строгая гарантия: если копирование бросит исключение, *this не
+    // изменится. Аллокатор other переходит к *this, только если это
+    // разрешает propagate_on_container_copy_assignment.
+    compact_bimap &operator=(compact_bimap const &other) {
+        if (this != &other) {
+            compact_bimap copy(other, propagate_on_copy::value ? other._alloc : _alloc);
+            take(copy, propagate_on_copy{});
+        }
+        return *this;
+    }
+
+    // Если аллокатор не переносится и аллокаторы различны, куски other не
+    // могут перейти к *this, и пары копируются.
+    compact_bimap &operator=(compact_bimap &&other) noexcept(
+            (propagate_on_move::value ||
+             std::allocator_traits<Allocator>::is_always_equal::value) &&
+            std::is_nothrow_copy_constructible_v<CompareLeft> &&
+            std::is_nothrow_copy_constructible_v<CompareRight>) {
+        if (this == &other) {
+            return *this;
+        }
+        if constexpr (!propagate_on_move::value) {
+            if (_alloc != other._alloc) {
+                return *this = static_cast<compact_bimap const &>(other);
+            }
+        }
+        compact_bimap moved(std::move(other));
+        take(moved, propagate_on_move{});
+        return *this;
+    }
+
+    ~compact_bimap() {
+        destroy_values();
+        deallocate_chunks(_left);
+        deallocate_chunks(_right);
+    }
+
+    // Аллокаторы должны быть равны, если propagate_on_container_swap
+    // ложно (как у pmr): иначе память одного ресурса освобождалась бы
+    // через другой.
+    void swap(compact_bimap &other) noexcept(std::is_nothrow_swappable_v<CompareLeft> &&
+                                             std::is_nothrow_swappable_v<CompareRight>) {
+        using std::swap;
+        if constexpr (std::allocator_traits<Allocator>::propagate_on_container_swap::value) {
+            swap(_alloc, other._alloc);
+        }
+        swap_contents(other);
+    }
+
+    friend void swap(compact_bimap &a, compact_bimap &b) noexcept(noexcept(a.swap(b))) {
+        a.swap(b);
+    }
+
+    // Вставка пары (left, right), возвращает итератор на left.
+    // Если такой left или такой right уже присутствуют, вставка не
+    // производится и возвращается end_left().
+    left_iterator insert(left_t const &left, right_t const &right) {
+        return insert_pair(left, right);
+    }
+
+    left_iterator insert(left_t const &left, right_t &&right) {
+        return insert_pair(left, std::move(right));
+    }
+
+    left_iterator insert(left_t &&left, right_t const &right) {
+        return insert_pair(std::move(left), right);
+    }
+
+    left_iterator insert(left_t &&left, right_t &&right) {
+        return insert_pair(std::move(left), std::move(right));
+    }
+
+    // Вставка диапазона пар по одной, с тем же результатом, что у
+    // bimap::insert_range: пара пропускается, если ее left или right уже
+    // есть. Treap не строится по готовому порядку, поэтому sorted_left
+    // ничего не меняет, кроме локальности спусков по левому дереву.
+    template <class InputIt> void insert_range(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            auto &&pair = *first;
+            insert_pair(std::get<0>(std::forward<decltype(pair)>(pair)),
+                        std::get<1>(std::forward<decltype(pair)>(pair)));
+        }
+    }
+
+    template <class InputIt> void insert_range(sorted_left_t, InputIt first, InputIt last) {
+        insert_range(first, last);
+    }
+
+    // Удаляет пару, возвращает итератор на следующий элемент той же стороны.
+    // erase(end_left()) и erase невалидного итератора неопределены.
+    left_iterator erase_left(left_iterator it) {
+        left_iterator next = it;
+        ++next;
+        erase_pair(it._id);
+        return next;
+    }
+
+    bool erase_left(left_t const &left) { return erase_id(_left.find(left)); }
+
+    right_iterator erase_right(right_iterator it) {
+        right_iterator next = it;
+        ++next;
+        erase_pair(it._id);
+        return next;
+    }
+
+    bool erase_right(right_t const &right) { return erase_id(_right.find(right)); }
+
+    left_iterator find_left(left_t const &left) const {
+        return left_iterator{this, _left.find(left)};
+    }
+
+    right_iterator find_right(right_t const &right) const {
+        return right_iterator{this, _right.find(right)};
+    }
+
+    // Если элемента не существует -- бросает std::out_of_range
+    right_t const &at_left(left_t const &key) const {
+        index id = _left.find(key);
+        if (id == nil) {
+            throw std::out_of_range{"at_left: not found"};
+        }
+        return _right.value(id);
+    }
+
+    left_t const &at_right(right_t const &key) const {
+        index id = _right.find(key);
+        if (id == nil) {
+            throw std::out_of_range{"at_right: not found"};
+        }
+        return _left.value(id);
+    }
+
+    left_iterator lower_bound_left(left_t const &left) const {
+        return left_iterator{this, _left.lower_bound(left)};
+    }
+
+    left_iterator upper_bound_left(left_t const &left) const {
+        return left_iterator{this, _left.upper_bound(left)};
+    }
+
+    right_iterator lower_bound_right(right_t const &right) const {
+        return right_iterator{this, _right.lower_bound(right)};
+    }
+
+    right_iterator upper_bound_right(right_t const &right) const {
+        return right_iterator{this, _right.upper_bound(right)};
+    }
+
+    left_iterator begin_left() const { return left_iterator{this, _left.first()}; }
+    left_iterator end_left() const { return left_iterator{this, nil}; }
+
+    right_iterator begin_right() const { return right_iterator{this, _right.first()}; }
+    right_iterator end_right() const { return right_iterator{this, nil}; }
+
+    allocator_type get_allocator() const { return _alloc; }
+
+    bool empty() const { return _size == 0; }
+
+    std::size_t size() const { return _size; }
+
+    friend bool operator==(compact_bimap const &a, compact_bimap const &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (auto it = a.begin_left(), other = b.begin_left(); it != a.end_left();
+             ++it, ++other) {
+            if (*it != *other || *it.flip() != *other.flip()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(compact_bimap const &a, compact_bimap const &b) {
+        return !(a == b);
+    }
+
+private:
+    using propagate_on_copy =
+            typename std::allocator_traits<Allocator>::propagate_on_container_copy_assignment;
+    using propagate_on_move =
+            typename std::allocator_traits<Allocator>::propagate_on_container_move_assignment;
+
+    // Обмен всем, кроме аллокатора.
+    void swap_contents(compact_bimap &other) noexcept(
+            std::is_nothrow_swappable_v<CompareLeft> &&
+            std::is_nothrow_swappable_v<CompareRight>) {
+        using std::swap;
+        swap_sides(_left, other._left);
+        swap_sides(_right, other._right);
+        swap(_size, other._size);
+        swap(_used, other._used);
+        swap(_free, other._free);
+    }
+
+    // Забирает содержимое source, куски которого выделены аллокатором,
+    // равным _alloc, или аллокатором, который переходит к *this вместе с
+    // ними (Propagate). Прежнее содержимое освобождает source.
+    template <bool Propagate>
+    void take(compact_bimap &source, std::bool_constant<Propagate>) {
+        if constexpr (Propagate) {
+            using std::swap;
+            swap(_alloc, source._alloc);
+        }
+        swap_contents(source);
+    }
+
+    template <class L, class R> left_iterator insert_pair(L &&left, R &&right) {
+        if (_left.find(left) != nil || _right.find(right) != nil) {
+            return end_left();
+        }
+        index id = acquire();
+        try {
+            ::new (static_cast<void *>(_left[id].storage)) Left(std::forward<L>(left));
+            try {
+                ::new (static_cast<void *>(_right[id].storage))
+                        Right(std::forward<R>(right));
+            } catch (...) {
+                _left[id].value().~Left();
+                throw;
+            }
+        } catch (...) {
+            release(id);
+            throw;
+        }
+        // Если компаратор бросит, дерево, в котором это случилось, остается
+        // прежним, а вставку в левое дерево отменяет unlink без сравнений.
+        try {
+            index *left_link = _left.insert(id);
+            try {
+                _right.insert(id);
+            } catch (...) {
+                _left.unlink(left_link);
+                throw;
+            }
+        } catch (...) {
+            _left[id].value().~Left();
+            _right[id].value().~Right();
+            release(id);
+            throw;
+        }
+        ++_size;
+        return left_iterator{this, id};
+    }
+
+    bool erase_id(index id) {
+        if (id == nil) {
+            return false;
+        }
+        erase_pair(id);
+        return true;
+    }
+
+    void erase_pair(index id) {
+        // Сравнения -- только при поиске связей, до изменения деревьев.
+        index *left_link = _left.link_to(id);
+        index *right_link = _right.link_to(id);
+        _left.unlink(left_link);
+        _right.unlink(right_link);
+        _left[id].value().~Left();
+        _right[id].value().~Right();
+        release(id);
+        --_size;
+    }
+
+    // Свободный индекс: из списка освобожденных или следующий по порядку,
+    // при необходимости с новым куском для обеих сторон.
+    index acquire() {
+        if (_free != nil) {
+            index id = _free;
+            _free = _left[id].left;
+            return id;
+        }
+        if (_used == nil) {
+            throw std::length_error{"compact_bimap: too many pairs"};
+        }
+        if ((_used & (chunk_size - 1)) == 0) {
+            add_chunk(_left);
+            try {
+                add_chunk(_right);
+            } catch (...) {
+                deallocate_chunk(_left, _left.chunks.back());
+                _left.chunks.pop_back();
+                throw;
+            }
+        }
+        return _used++;
+    }
+
+    void release(index id) {
+        _left[id].left = _free;
+        _left[id].right = id;
+        _free = id;
+    }
+
+    bool occupied(index id) const { return _left[id].right != id; }
+
+    template <class Side> void add_chunk(Side &s) {
+        using slot_t = typename Side::slot_t;
+        rebind<slot_t> alloc(_alloc);
+        s.chunks.reserve(s.chunks.size() + 1);
+        s.chunks.push_back(std::allocator_traits<rebind<slot_t>>::allocate(alloc, chunk_size));
+    }
+
+    template <class Side> void deallocate_chunk(Side &, typename Side::slot_t *chunk) {
+        using slot_t = typename Side::slot_t;
+        rebind<slot_t> alloc(_alloc);
+        std::allocator_traits<rebind<slot_t>>::deallocate(alloc, chunk, chunk_size);
+    }
+
+    template <class Side> void deallocate_chunks(Side &s) {
+        for (auto *chunk : s.chunks) {
+            deallocate_chunk(s, chunk);
+        }
+        s.chunks.clear();
+    }
+
+    template <class Side> static void swap_sides(Side &a, Side &b) {
+        using std::swap;
+        swap(a.chunks, b.chunks);
+        swap(a.root, b.root);
+        swap(a.comparator, b.comparator);
+    }
+
+    // Не аллоцирует: свободные слоты отмечены в них самих (см. slot).
+    void destroy_values() noexcept {
+        if constexpr (!std::is_trivially_destructible_v<Left> ||
+                      !std::is_trivially_destructible_v<Right>) {
+            for (index id = 0; id < _used; ++id) {
+                if (occupied(id)) {
+                    _left[id].value().~Left();
+                    _right[id].value().~Right();
+                }
+            }
+        }
+    }
+
+    // Копирует слоты other в пустой *this. Если копирование значения
+    // бросит, уже скопированные значения разрушаются, а *this остается
+    // пустым.
+    void copy_slots(compact_bimap const &other) {
+        while (_left.chunks.size() < other._left.chunks.size()) {
+            add_chunk(_left);
+            add_chunk(_right);
+        }
+        index id = 0;
+        try {
+            for (; id < other._used; ++id) {
+                _left[id].left = other._left[id].left;
+                _left[id].right = other._left[id].right;
+                _right[id].left = other._right[id].left;
+                _right[id].right = other._right[id].right;
+                if (other.occupied(id)) {
+                    ::new (static_cast<void *>(_left[id].storage))
+                            Left(other._left.value(id));
+                    try {
+                        ::new (static_cast<void *>(_right[id].storage))
+                                Right(other._right.value(id));
+                    } catch (...) {
+                        _left[id].value().~Left();
+                        throw;
+                    }
+                }
+            }
+        } catch (...) {
+            for (index done = 0; done < id; ++done) {
+                if (other.occupied(done)) {
+                    _left[done].value().~Left();
+                    _right[done].value().~Right();
+                }
+            }
+            throw;
+        }
+        _left.root = other._left.root;
+        _right.root = other._right.root;
+        _size = other._size;
+        _used = other._used;
+        _free = other._free;
+    }
+
+    left_side _left;
+    right_side _right;
+    Allocator _alloc;
+    std::size_t _size = 0;
+    // Индексы [0, _used) хоть раз выдавались; _free -- голова списка
+    // освобожденных из них.
+    index _used = 0;
+    index _free = nil;
+};
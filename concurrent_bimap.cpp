@@ -0,0 +1,274 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Потокобезопасный bimap: пары разложены по шардам, у каждого шарда свой
+// bimap и свой std::shared_mutex. Чтения берут один шард на чтение,
+// вставка и удаление -- не больше двух шардов на запись.
+// Пара (l, r) лежит в шарде left-ключа и в шарде right-ключа (если это
+// разные шарды, то в двух копиях). Шард ключа поэтому содержит все пары с
+// этим ключом, и проверка уникальности left и right при вставке -- поиск
+// в двух шардах под их блокировками. Чужие пары в шарде поиску не мешают:
+// пара, лежащая в шарде из-за своего right, может совпасть с искомым left
+// только если ее left ведет в тот же шард.
+// Все операции линеаризуемы: каждая выполняется целиком под блокировками
+// шардов, которых касается. Два шарда блокируются по возрастанию номера,
+// поэтому взаимных блокировок нет.
+// Итераторов нет: значения возвращаются копиями. По умолчанию шарды --
+// хешированные bimap'ы (порядок здесь все равно недоступен); поиск в
+// шарде идет через константный bimap и дерево не меняет, политика
+// splay_on_read поэтому запрещена.
+template <typename Left, typename Right, typename CompareLeft = hashed<>,
+          typename CompareRight = hashed<>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>,
+          typename... Policies>
+struct concurrent_bimap {
+    using left_t = Left;
+    using right_t = Right;
+    using allocator_type = Allocator;
+    using shard_type = bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>;
+
+    static_assert(read_splay_period<Policies...>::value == 0,
+                  "concurrent_bimap searches shards under shared locks, "
+                  "splay_on_read would modify them");
+
+    // Число шардов по умолчанию: степень двойки, не меньше четырех на
+    // аппаратный поток, чтобы два потока редко попадали в один шард.
+    static size_t default_shards() {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t shards = 1;
+        while (shards < threads * 4) {
+            shards *= 2;
+        }
+        return shards;
+    }
+
+    // Число шардов округляется вверх до степени двойки.
+    explicit concurrent_bimap(size_t shards = default_shards(),
+                              CompareLeft compare_left = CompareLeft(),
+                              CompareRight compare_right = CompareRight(),
+                              Allocator const &alloc = Allocator())
+            : _compare_left(compare_left), _compare_right(compare_right) {
+        size_t count = 1;
+        while (count < shards) {
+            count *= 2;
+        }
+        _shards.reset(new shard[count]);
+        _mask = count - 1;
+        for (size_t i = 0; i < count; ++i) {
+            _shards[i].pairs = shard_type(compare_left, compare_right, alloc);
+        }
+    }
+
+    concurrent_bimap(concurrent_bimap const &) = delete;
+    concurrent_bimap &operator=(concurrent_bimap const &) = delete;
+
+    // Вставляет пару, если ни left, ни right еще нет. Возвращает, была ли
+    // пара вставлена.
+    template <class L, class R> bool insert(L &&left, R &&right) {
+        size_t const l = left_shard(left);
+        size_t const r = right_shard(right);
+        auto locks = lock_two(l, r);
+        shard_type &home = _shards[l].pairs;
+        shard_type &other = _shards[r].pairs;
+        if (std::as_const(home).find_left(left) != home.end_left() ||
+            std::as_const(other).find_right(right) != other.end_right()) {
+            return false;
+        }
+        if (l == r) {
+            home.insert(std::forward<L>(left), std::forward<R>(right));
+        } else {
+            auto placed = home.insert(left, right);
+            try {
+                other.insert(std::forward<L>(left), std::forward<R>(right));
+            } catch (...) {
+                // Удаление по итератору не вызывает компаратор, поэтому
+                // откат не бросает, даже если бросил компаратор.
+                home.erase_left(placed);
+                throw;
+            }
+        }
+        ++_shards[l].owned;
+        return true;
+    }
+
+    // Удаляет пару по ключу, возвращает, была ли она.
+    bool erase_left(left_t const &left) {
+        return erase_pair(
+                left_shard(left), true,
+                [&](shard_type const &pairs) {
+                    auto it = pairs.find_left(left);
+                    return it == pairs.end_left() ? npos : right_shard(*it.flip());
+                },
+                [&](shard_type &pairs) { return pairs.find_left(left); });
+    }
+
+    bool erase_right(right_t const &right) {
+        return erase_pair(
+                right_shard(right), false,
+                [&](shard_type const &pairs) {
+                    auto it = pairs.find_right(right);
+                    return it == pairs.end_right() ? npos : left_shard(*it.flip());
+                },
+                [&](shard_type &pairs) { return pairs.find_right(right).flip(); });
+    }
+
+    // Парный элемент или пустой optional, если ключа нет.
+    std::optional<right_t> find_left(left_t const &left) const {
+        shard const &s = _shards[left_shard(left)];
+        std::shared_lock lock(s.mutex);
+        auto it = s.pairs.find_left(left);
+        if (it == s.pairs.end_left()) {
+            return std::nullopt;
+        }
+        return *it.flip();
+    }
+
+    std::optional<left_t> find_right(right_t const &right) const {
+        shard const &s = _shards[right_shard(right)];
+        std::shared_lock lock(s.mutex);
+        auto it = s.pairs.find_right(right);
+        if (it == s.pairs.end_right()) {
+            return std::nullopt;
+        }
+        return *it.flip();
+    }
+
+    // То же, что find_*, но отсутствие ключа -- std::out_of_range.
+    right_t at_left(left_t const &left) const {
+        shard const &s = _shards[left_shard(left)];
+        std::shared_lock lock(s.mutex);
+        return s.pairs.at_left(left);
+    }
+
+    left_t at_right(right_t const &right) const {
+        shard const &s = _shards[right_shard(right)];
+        std::shared_lock lock(s.mutex);
+        return s.pairs.at_right(right);
+    }
+
+    // Число пар. Блокирует на чтение все шарды сразу, поэтому тоже
+    // линеаризуемо, но дорого: не для частых вызовов.
+    size_t size() const {
+        std::unique_ptr<std::shared_lock<std::shared_mutex>[]> locks(
+                new std::shared_lock<std::shared_mutex>[_mask + 1]);
+        size_t total = 0;
+        for (size_t i = 0; i <= _mask; ++i) {
+            locks[i] = std::shared_lock(_shards[i].mutex);
+            total += _shards[i].owned;
+        }
+        return total;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t shard_count() const { return _mask + 1; }
+
+private:
+    static constexpr size_t npos = SIZE_MAX;
+
+    // Шард на своей кэш-линии: блокировки соседних шардов не делят линию.
+    struct alignas(64) shard {
+        mutable std::shared_mutex mutex;
+        shard_type pairs;
+        // Пары, чей left ведет в этот шард: каждая пара считается один раз.
+        size_t owned{};
+    };
+
+    // Хеш ключа: hash хешированной стороны или std::hash для упорядоченной.
+    template <class Compare, class K> static size_t key_hash(Compare const &, K const &key) {
+        return std::hash<K>{}(key);
+    }
+
+    template <class Hash, class Equal, class K>
+    static size_t key_hash(hashed<Hash, Equal> const &compare, K const &key) {
+        return compare.hash(key);
+    }
+
+    // Шард берется из младших бит перемешанного хеша: хешированный bimap
+    // шарда выбирает ячейку по старшим битам произведения на 2^64 / phi, и
+    // ключи одного шарда должны расходиться по всей его таблице.
+    size_t shard_of(std::uint64_t h) const {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h) & _mask;
+    }
+
+    size_t left_shard(left_t const &left) const {
+        return shard_of(key_hash(_compare_left, left));
+    }
+
+    size_t right_shard(right_t const &right) const {
+        return shard_of(key_hash(_compare_right, right));
+    }
+
+    using write_lock = std::unique_lock<std::shared_mutex>;
+
+    // Блокирует шарды a и b на запись по возрастанию номера.
+    std::pair<write_lock, write_lock> lock_two(size_t a, size_t b) {
+        if (a > b) {
+            std::swap(a, b);
+        }
+        write_lock first(_shards[a].mutex);
+        if (a == b) {
+            return {std::move(first), write_lock()};
+        }
+        return {std::move(first), write_lock(_shards[b].mutex)};
+    }
+
+    // Удаление пары, найденной по ключу в шарде home. partner по bimap
+    // шарда возвращает шард второго ключа пары или npos, find находит пару
+    // в bimap шарда (left_iterator). Шард партнера известен только после поиска, поэтому
+    // сначала он узнается под блокировкой на чтение, затем оба шарда
+    // блокируются по порядку и поиск повторяется: если пару за это время
+    // заменили, попытка повторяется с новым шардом партнера.
+    template <class Partner, class Find>
+    bool erase_pair(size_t home, bool home_is_left, Partner partner, Find find) {
+        size_t other;
+        {
+            std::shared_lock lock(_shards[home].mutex);
+            other = partner(_shards[home].pairs);
+        }
+        while (other != npos) {
+            auto locks = lock_two(home, other);
+            size_t const current = partner(std::as_const(_shards[home].pairs));
+            if (current == other) {
+                // Копии пары находятся в обоих шардах до удаления: сравнения,
+                // которые могут бросить, идут раньше изменений, а удаление
+                // по итератору компаратор не вызывает.
+                shard_type &here = _shards[home].pairs;
+                shard_type &there = _shards[other].pairs;
+                auto here_it = find(here);
+                auto there_it = other != home ? find(there) : here_it;
+                here.erase_left(here_it);
+                if (other != home) {
+                    there.erase_left(there_it);
+                }
+                --_shards[home_is_left ? home : other].owned;
+                return true;
+            }
+            other = current;
+        }
+        return false;
+    }
+
+    std::unique_ptr<shard[]> _shards;
+    size_t _mask{};
+    CompareLeft _compare_left;
+    CompareRight _compare_right;
+};
@@ -0,0 +1,815 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bimap в отсортированных массивах для данных, которые строятся один раз и
+// потом много читаются. Каждая сторона -- массив своих значений по
+// возрастанию и параллельный ему массив позиций парных элементов на другой
+// стороне, так что итератор -- это позиция, а flip() -- одно чтение из
+// массива. Поиск -- бинарный поиск без ветвлений по непрерывной памяти
+// вместо спуска по узлам. На пару приходится sizeof(Left) + sizeof(Right)
+// + 8 байт.
+// Цена: одиночные insert и erase двигают массивы и перенумеровывают
+// позиции другой стороны за O(n). Изменения пачками (insert_range,
+// erase диапазона, assign) проходят массивы один раз за O(n + k log k).
+// Любое изменение инвалидирует все итераторы.
+// Интерфейс тот же, что у bimap, кроме того, что массивам не нужно или
+// недоступно: node handle и merge, emplace, политики, пакетный поиск
+// find_*_many и статистика instrumented.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>>
+struct flat_bimap {
+    using left_t = Left;
+    using right_t = Right;
+    using allocator_type = Allocator;
+    using index = std::uint32_t;
+
+private:
+    template <class T>
+    using rebind = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+    template <class T> using array = std::vector<T, rebind<T>>;
+
+    // Одна сторона: values по возрастанию, other[i] -- позиция парного к
+    // values[i] элемента на другой стороне.
+    template <class T, class Compare> struct side {
+        using type = T;
+
+        side(Compare compare, Allocator const &alloc)
+                : values(rebind<T>(alloc)), other(rebind<index>(alloc)),
+                  comparator(compare) {}
+
+        index size() const { return static_cast<index>(values.size()); }
+
+        // Бинарный поиск без ветвлений: на каждом шаге остается верхняя
+        // или нижняя половина, выбор компилируется в cmov, а не в переход,
+        // который на случайных ключах предсказывается в половине случаев.
+        // Обе возможные середины следующего шага запрашиваются заранее,
+        // поэтому промахи кэша соседних шагов перекрываются.
+        // На массивах больше branchless_limit почти каждый шаг -- промах
+        // мимо кэша и TLB, и выигрыш пропадает: at_left на int при 1e7 и
+        // 3e7 парах на 2-8% медленнее std::lower_bound (при 1e6 -- в 1.6
+        // раза быстрее). Там используется обычный поиск.
+        static constexpr size_t branchless_limit = size_t{1} << 23;
+
+        template <class K> index lower_bound(K const &key) const {
+            T const *base = values.data();
+            size_t n = values.size();
+            if (n == 0) {
+                return 0;
+            }
+            if (n > branchless_limit) {
+                return static_cast<index>(
+                        std::lower_bound(base, base + n, key, comparator) - base);
+            }
+            while (n > 1) {
+                size_t half = n / 2;
+#if defined(__GNUC__)
+                __builtin_prefetch(base + half / 2);
+                __builtin_prefetch(base + half + half / 2);
+#endif
+                base = comparator(base[half], key) ? base + half : base;
+                n -= half;
+            }
+            return static_cast<index>(base - values.data()) + comparator(*base, key);
+        }
+
+        template <class K> index upper_bound(K const &key) const {
+            T const *base = values.data();
+            size_t n = values.size();
+            if (n == 0) {
+                return 0;
+            }
+            if (n > branchless_limit) {
+                return static_cast<index>(
+                        std::upper_bound(base, base + n, key, comparator) - base);
+            }
+            while (n > 1) {
+                size_t half = n / 2;
+#if defined(__GNUC__)
+                __builtin_prefetch(base + half / 2);
+                __builtin_prefetch(base + half + half / 2);
+#endif
+                base = comparator(key, base[half]) ? base : base + half;
+                n -= half;
+            }
+            return static_cast<index>(base - values.data()) + !comparator(key, *base);
+        }
+
+        // Позиция key или size(), если его нет.
+        template <class K> index find(K const &key) const {
+            index i = lower_bound(key);
+            return i != size() && !comparator(key, values[i]) ? i : size();
+        }
+
+        array<T> values;
+        array<index> other;
+        Compare comparator;
+    };
+
+    using left_side = side<Left, CompareLeft>;
+    using right_side = side<Right, CompareRight>;
+
+public:
+    struct right_iterator;
+
+    struct left_iterator {
+        left_iterator(flat_bimap const *map, index pos) : _map(map), _pos(pos) {}
+
+        // Разыменование end_left() и невалидного итератора неопределено.
+        left_t const &operator*() const { return _map->_left.values[_pos]; }
+
+        left_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+
+        left_iterator operator++(int) {
+            left_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        left_iterator &operator--() {
+            --_pos;
+            return *this;
+        }
+
+        left_iterator operator--(int) {
+            left_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        // Итератор на right той же пары, end_left().flip() -- end_right().
+        right_iterator flip() const {
+            return right_iterator{_map, _pos == _map->_left.size() ? _pos
+                                                                   : _map->_left.other[_pos]};
+        }
+
+        [[nodiscard]] bool operator==(left_iterator it) const { return _pos == it._pos; }
+        [[nodiscard]] bool operator!=(left_iterator it) const { return !(*this == it); }
+
+        flat_bimap const *_map;
+        index _pos;
+    };
+
+    struct right_iterator {
+        right_iterator(flat_bimap const *map, index pos) : _map(map), _pos(pos) {}
+
+        right_t const &operator*() const { return _map->_right.values[_pos]; }
+
+        right_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+
+        right_iterator operator++(int) {
+            right_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        right_iterator &operator--() {
+            --_pos;
+            return *this;
+        }
+
+        right_iterator operator--(int) {
+            right_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        left_iterator flip() const {
+            return left_iterator{_map, _pos == _map->_right.size() ? _pos
+                                                                   : _map->_right.other[_pos]};
+        }
+
+        [[nodiscard]] bool operator==(right_iterator it) const { return _pos == it._pos; }
+        [[nodiscard]] bool operator!=(right_iterator it) const { return !(*this == it); }
+
+        flat_bimap const *_map;
+        index _pos;
+    };
+
+    flat_bimap(CompareLeft compare_left = CompareLeft(),
+               CompareRight compare_right = CompareRight(),
+               Allocator const &alloc = Allocator())
+            : _left(compare_left, alloc), _right(compare_right, alloc) {}
+
+    explicit flat_bimap(Allocator const &alloc)
+            : flat_bimap(CompareLeft(), CompareRight(), alloc) {}
+
+    // Создает flat_bimap из диапазона пар, см. insert_range.
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    flat_bimap(InputIt first, InputIt last, CompareLeft compare_left = CompareLeft(),
+               CompareRight compare_right = CompareRight(),
+               Allocator const &alloc = Allocator())
+            : flat_bimap(compare_left, compare_right, alloc) {
+        insert_range(first, last);
+    }
+
+    template <class InputIt,
+              class = typename std::iterator_traits<InputIt>::iterator_category>
+    flat_bimap(sorted_left_t, InputIt first, InputIt last,
+               CompareLeft compare_left = CompareLeft(),
+               CompareRight compare_right = CompareRight(),
+               Allocator const &alloc = Allocator())
+            : flat_bimap(compare_left, compare_right, alloc) {
+        insert_range(sorted_left, first, last);
+    }
+
+    void swap(flat_bimap &other) noexcept(std::is_nothrow_swappable_v<CompareLeft> &&
+                                          std::is_nothrow_swappable_v<CompareRight>) {
+        swap_sides(_left, other._left);
+        swap_sides(_right, other._right);
+    }
+
+    friend void swap(flat_bimap &a, flat_bimap &b) noexcept(noexcept(a.swap(b))) {
+        a.swap(b);
+    }
+
+    // Вставка пары (left, right), возвращает итератор на left.
+    // Если такой left или такой right уже присутствуют, вставка не
+    // производится и возвращается end_left(). O(n): для многих пар
+    // используйте insert_range.
+    left_iterator insert(left_t const &left, right_t const &right) {
+        return insert_pair(left, right);
+    }
+
+    left_iterator insert(left_t const &left, right_t &&right) {
+        return insert_pair(left, std::move(right));
+    }
+
+    left_iterator insert(left_t &&left, right_t const &right) {
+        return insert_pair(std::move(left), right);
+    }
+
+    left_iterator insert(left_t &&left, right_t &&right) {
+        return insert_pair(std::move(left), std::move(right));
+    }
+
+    // Массовая вставка диапазона пар. Результат тот же, что у insert по
+    // одной паре в порядке диапазона: пара пропускается, если ее left или
+    // right уже есть во flat_bimap или в одной из ранее вставленных пар
+    // диапазона. Диапазон сортируется по каждой стороне и сливается с
+    // массивами одним проходом. Если исключение брошено (компаратором,
+    // аллокатором или копированием значения), flat_bimap не меняется.
+    template <class InputIt> void insert_range(InputIt first, InputIt last) {
+        bulk_insert(first, last, false);
+    }
+
+    // То же для диапазона, упорядоченного по left: сортировка по left
+    // пропускается. Неупорядоченный диапазон -- неопределенное поведение.
+    template <class InputIt>
+    void insert_range(sorted_left_t, InputIt first, InputIt last) {
+        bulk_insert(first, last, true);
+    }
+
+    // Заменяет содержимое парами диапазона, строгая гарантия.
+    template <class InputIt> void assign(InputIt first, InputIt last) {
+        flat_bimap other(first, last, _left.comparator, _right.comparator, get_allocator());
+        swap(other);
+    }
+
+    template <class InputIt>
+    void assign(sorted_left_t, InputIt first, InputIt last) {
+        flat_bimap other(sorted_left, first, last, _left.comparator, _right.comparator,
+                         get_allocator());
+        swap(other);
+    }
+
+    // Удаляет пару, возвращает итератор на следующий элемент той же стороны.
+    // erase(end_left()) и erase невалидного итератора неопределены.
+    left_iterator erase_left(left_iterator it) {
+        erase_pair(it._pos, _left.other[it._pos]);
+        return it;
+    }
+
+    bool erase_left(left_t const &left) { return erase_left_at(_left.find(left)); }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    bool erase_left(K const &left) {
+        return erase_left_at(_left.find(left));
+    }
+
+    right_iterator erase_right(right_iterator it) {
+        erase_pair(_right.other[it._pos], it._pos);
+        return it;
+    }
+
+    bool erase_right(right_t const &right) { return erase_right_at(_right.find(right)); }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    bool erase_right(K const &right) {
+        return erase_right_at(_right.find(right));
+    }
+
+    // Удаляет [first, last) за один проход по обеим сторонам, возвращает
+    // итератор на элемент, следовавший за диапазоном.
+    left_iterator erase_left(left_iterator first, left_iterator last) {
+        erase_range(_left, _right, first._pos, last._pos);
+        return first;
+    }
+
+    right_iterator erase_right(right_iterator first, right_iterator last) {
+        erase_range(_right, _left, first._pos, last._pos);
+        return first;
+    }
+
+    // Возвращает итератор по элементу. Если не найден - соответствующий end()
+    left_iterator find_left(left_t const &left) const {
+        return left_iterator{this, _left.find(left)};
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator find_left(K const &left) const {
+        return left_iterator{this, _left.find(left)};
+    }
+
+    right_iterator find_right(right_t const &right) const {
+        return right_iterator{this, _right.find(right)};
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator find_right(K const &right) const {
+        return right_iterator{this, _right.find(right)};
+    }
+
+    // Возвращает противоположный элемент по элементу
+    // Если элемента не существует -- бросает std::out_of_range
+    right_t const &at_left(left_t const &key) const {
+        return at_key(_left, _right, key, "at_left: not found");
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    right_t const &at_left(K const &key) const {
+        return at_key(_left, _right, key, "at_left: not found");
+    }
+
+    left_t const &at_right(right_t const &key) const {
+        return at_key(_right, _left, key, "at_right: not found");
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    left_t const &at_right(K const &key) const {
+        return at_key(_right, _left, key, "at_right: not found");
+    }
+
+    // Возвращает противоположный элемент по элементу
+    // Если элемента не существует, добавляет его с дефолтным элементом на
+    // противоположной стороне. Если дефолтный элемент уже в паре, его
+    // пара переходит к key. O(n), как insert.
+    right_t const &at_left_or_default(left_t const &key) {
+        index l = _left.find(key);
+        if (l != _left.size()) {
+            return _right.values[_left.other[l]];
+        }
+        right_t value{};
+        index r = _right.find(value);
+        if (r == _right.size()) {
+            l = insert_pair(key, std::move(value))._pos;
+            return _right.values[_left.other[l]];
+        }
+        relink_value(_left, _right, _right.other[r], key);
+        return _right.values[r];
+    }
+
+    left_t const &at_right_or_default(right_t const &key) {
+        index r = _right.find(key);
+        if (r != _right.size()) {
+            return _left.values[_right.other[r]];
+        }
+        left_t value{};
+        index l = _left.find(value);
+        if (l == _left.size()) {
+            l = insert_pair(std::move(value), key)._pos;
+            return _left.values[l];
+        }
+        relink_value(_right, _left, _left.other[l], key);
+        return _left.values[l];
+    }
+
+    left_iterator lower_bound_left(left_t const &left) const {
+        return left_iterator{this, _left.lower_bound(left)};
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator lower_bound_left(K const &left) const {
+        return left_iterator{this, _left.lower_bound(left)};
+    }
+
+    left_iterator upper_bound_left(left_t const &left) const {
+        return left_iterator{this, _left.upper_bound(left)};
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    left_iterator upper_bound_left(K const &left) const {
+        return left_iterator{this, _left.upper_bound(left)};
+    }
+
+    right_iterator lower_bound_right(right_t const &right) const {
+        return right_iterator{this, _right.lower_bound(right)};
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator lower_bound_right(K const &right) const {
+        return right_iterator{this, _right.lower_bound(right)};
+    }
+
+    right_iterator upper_bound_right(right_t const &right) const {
+        return right_iterator{this, _right.upper_bound(right)};
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    right_iterator upper_bound_right(K const &right) const {
+        return right_iterator{this, _right.upper_bound(right)};
+    }
+
+    // Порядковые статистики достаются массивам даром, за O(1) и O(log n).
+    left_iterator nth_left(size_t k) const {
+        return left_iterator{this, static_cast<index>(std::min<size_t>(k, size()))};
+    }
+
+    right_iterator nth_right(size_t k) const {
+        return right_iterator{this, static_cast<index>(std::min<size_t>(k, size()))};
+    }
+
+    size_t rank_left(left_t const &key) const { return _left.lower_bound(key); }
+
+    size_t rank_right(right_t const &key) const { return _right.lower_bound(key); }
+
+    // Число элементов стороны в [from, to).
+    size_t count_range_left(left_t const &from, left_t const &to) const {
+        return count_range(_left, from, to);
+    }
+
+    template <class K, class C = CompareLeft, class = typename C::is_transparent>
+    size_t count_range_left(K const &from, K const &to) const {
+        return count_range(_left, from, to);
+    }
+
+    size_t count_range_right(right_t const &from, right_t const &to) const {
+        return count_range(_right, from, to);
+    }
+
+    template <class K, class C = CompareRight, class = typename C::is_transparent>
+    size_t count_range_right(K const &from, K const &to) const {
+        return count_range(_right, from, to);
+    }
+
+    left_iterator begin_left() const { return left_iterator{this, 0}; }
+    left_iterator end_left() const { return left_iterator{this, _left.size()}; }
+
+    right_iterator begin_right() const { return right_iterator{this, 0}; }
+    right_iterator end_right() const { return right_iterator{this, _right.size()}; }
+
+    allocator_type get_allocator() const {
+        return allocator_type(_left.values.get_allocator());
+    }
+
+    bool empty() const { return _left.values.empty(); }
+
+    std::size_t size() const { return _left.values.size(); }
+
+    friend bool operator==(flat_bimap const &a, flat_bimap const &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (index i = 0; i < a._left.size(); ++i) {
+            if (a._left.values[i] != b._left.values[i] ||
+                a._right.values[a._left.other[i]] != b._right.values[b._left.other[i]]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(flat_bimap const &a, flat_bimap const &b) { return !(a == b); }
+
+private:
+    // Наибольший допустимый размер: позиция end() тоже должна помещаться
+    // в index.
+    static constexpr size_t max_pairs = UINT32_MAX;
+
+    template <class Side, class Other, class K>
+    static typename Other::type const &at_key(Side const &side, Other const &other,
+                                               K const &key, char const *message) {
+        index i = side.find(key);
+        if (i == side.size()) {
+            throw std::out_of_range{message};
+        }
+        return other.values[side.other[i]];
+    }
+
+    template <class Side, class K>
+    static size_t count_range(Side const &side, K const &from, K const &to) {
+        index begin = side.lower_bound(from);
+        index end = side.lower_bound(to);
+        return end > begin ? end - begin : 0;
+    }
+
+    // Заменяет значение в позиции from стороны side на key, которого на
+    // ней нет, и переставляет его на место по порядку. Позиции между
+    // старым и новым местом сдвигаются на одну, парные ссылки другой
+    // стороны на них обновляются.
+    template <class Side, class Other, class K>
+    static void relink_value(Side &side, Other &other, index from, K const &key) {
+        index to = side.lower_bound(key);
+        if (to > from) {
+            --to;
+        }
+        side.values[from] = key;
+        auto rotate = [&](auto &a) {
+            if (to > from) {
+                std::rotate(a.begin() + from, a.begin() + from + 1, a.begin() + to + 1);
+            } else {
+                std::rotate(a.begin() + to, a.begin() + from, a.begin() + from + 1);
+            }
+        };
+        rotate(side.values);
+        rotate(side.other);
+        for (index i = std::min(from, to); i <= std::max(from, to); ++i) {
+            other.other[side.other[i]] = i;
+        }
+    }
+
+    template <class L, class R> left_iterator insert_pair(L &&left, R &&right) {
+        index l = _left.lower_bound(left);
+        if (l != _left.size() && !_left.comparator(left, _left.values[l])) {
+            return end_left();
+        }
+        index r = _right.lower_bound(right);
+        if (r != _right.size() && !_right.comparator(right, _right.values[r])) {
+            return end_left();
+        }
+        if (size() == max_pairs) {
+            throw std::length_error{"flat_bimap: too many pairs"};
+        }
+        // После reserve вставки индексов не бросают, а вставленный left
+        // убирается, если бросит вставка right.
+        _left.other.reserve(size() + 1);
+        _right.other.reserve(size() + 1);
+        _left.values.insert(_left.values.begin() + l, std::forward<L>(left));
+        try {
+            _right.values.insert(_right.values.begin() + r, std::forward<R>(right));
+        } catch (...) {
+            _left.values.erase(_left.values.begin() + l);
+            throw;
+        }
+        for (index &pos : _left.other) {
+            pos += pos >= r;
+        }
+        for (index &pos : _right.other) {
+            pos += pos >= l;
+        }
+        _left.other.insert(_left.other.begin() + l, r);
+        _right.other.insert(_right.other.begin() + r, l);
+        return left_iterator{this, l};
+    }
+
+    bool erase_left_at(index l) {
+        if (l == _left.size()) {
+            return false;
+        }
+        erase_pair(l, _left.other[l]);
+        return true;
+    }
+
+    bool erase_right_at(index r) {
+        if (r == _right.size()) {
+            return false;
+        }
+        erase_pair(_right.other[r], r);
+        return true;
+    }
+
+    void erase_pair(index l, index r) {
+        _left.values.erase(_left.values.begin() + l);
+        _left.other.erase(_left.other.begin() + l);
+        _right.values.erase(_right.values.begin() + r);
+        _right.other.erase(_right.other.begin() + r);
+        for (index &pos : _left.other) {
+            pos -= pos > r;
+        }
+        for (index &pos : _right.other) {
+            pos -= pos > l;
+        }
+    }
+
+    // Удаляет позиции [first, last) стороны primary и парные им элементы
+    // secondary. Позиции secondary сдвигаются на число удаленных перед
+    // ними: таблица сдвигов строится одним проходом по отметкам.
+    template <class Primary, class Secondary>
+    static void erase_range(Primary &primary, Secondary &secondary, index first,
+                            index last) {
+        if (first == last) {
+            return;
+        }
+        index const n = primary.size();
+        index const k = last - first;
+        std::vector<index> shifted(n);
+        for (index i = first; i < last; ++i) {
+            shifted[primary.other[i]] = 1;
+        }
+        index removed = 0;
+        index kept = 0;
+        for (index j = 0; j < n; ++j) {
+            if (shifted[j] != 0) {
+                ++removed;
+                continue;
+            }
+            if (kept != j) {
+                secondary.values[kept] = std::move(secondary.values[j]);
+            }
+            index pos = secondary.other[j];
+            secondary.other[kept] = pos < first ? pos : pos - k;
+            shifted[j] = kept++;
+        }
+        secondary.values.erase(secondary.values.begin() + kept, secondary.values.end());
+        secondary.other.resize(kept);
+
+        primary.values.erase(primary.values.begin() + first, primary.values.begin() + last);
+        primary.other.erase(primary.other.begin() + first, primary.other.begin() + last);
+        for (index &pos : primary.other) {
+            pos = shifted[pos];
+        }
+    }
+
+    template <class InputIt>
+    void bulk_insert(InputIt first, InputIt last, bool left_sorted) {
+        array<Left> lefts(_left.values.get_allocator());
+        array<Right> rights(_right.values.get_allocator());
+        if constexpr (std::is_base_of_v<
+                              std::forward_iterator_tag,
+                              typename std::iterator_traits<InputIt>::iterator_category>) {
+            size_t count = static_cast<size_t>(std::distance(first, last));
+            lefts.reserve(count);
+            rights.reserve(count);
+        }
+        for (; first != last; ++first) {
+            auto &&pair = *first;
+            lefts.push_back(std::get<0>(std::forward<decltype(pair)>(pair)));
+            rights.push_back(std::get<1>(std::forward<decltype(pair)>(pair)));
+        }
+        size_t const k = lefts.size();
+        if (k == 0) {
+            return;
+        }
+
+        std::vector<size_t> by_left(k), by_right(k);
+        std::vector<size_t> left_class(k), right_class(k);
+        std::vector<char> left_taken(k), right_taken(k);
+        classify(_left, lefts, left_sorted, by_left, left_class, left_taken);
+        classify(_right, rights, false, by_right, right_class, right_taken);
+
+        std::vector<char> accepted(k);
+        size_t accepted_count = 0;
+        for (size_t i = 0; i < k; ++i) {
+            if (!left_taken[left_class[i]] && !right_taken[right_class[i]]) {
+                accepted[i] = left_taken[left_class[i]] = right_taken[right_class[i]] = 1;
+                ++accepted_count;
+            }
+        }
+        if (accepted_count == 0) {
+            return;
+        }
+        if (size() + accepted_count > max_pairs) {
+            throw std::length_error{"flat_bimap: too many pairs"};
+        }
+
+        // Новые позиции старых элементов (old_*) и вставляемых пар (new_*).
+        // Сначала все, что может бросить: сравнения слияния и выделение
+        // памяти. Значения переносятся потом, и сторона, перенос которой
+        // может бросить (копированием), переносится первой: ее значения
+        // копируются, так что при исключении массивы не тронуты.
+        std::vector<index> old_left(size()), old_right(size());
+        std::vector<index> new_left(k), new_right(k);
+        merge_positions(_left, lefts, by_left, accepted, old_left, new_left);
+        merge_positions(_right, rights, by_right, accepted, old_right, new_right);
+        left_side left(_left.comparator, get_allocator());
+        right_side right(_right.comparator, get_allocator());
+        left.other.resize(size() + accepted_count);
+        right.other.resize(size() + accepted_count);
+        left.values.reserve(size() + accepted_count);
+        right.values.reserve(size() + accepted_count);
+        if constexpr (std::is_nothrow_move_constructible_v<Left>) {
+            fill_side(_right, rights, by_right, accepted, old_right, new_right, right);
+            fill_side(_left, lefts, by_left, accepted, old_left, new_left, left);
+        } else {
+            fill_side(_left, lefts, by_left, accepted, old_left, new_left, left);
+            fill_side(_right, rights, by_right, accepted, old_right, new_right, right);
+        }
+
+        for (index i = 0; i < _left.size(); ++i) {
+            left.other[old_left[i]] = old_right[_left.other[i]];
+            right.other[old_right[_left.other[i]]] = old_left[i];
+        }
+        for (size_t i = 0; i < k; ++i) {
+            if (accepted[i]) {
+                left.other[new_left[i]] = new_right[i];
+                right.other[new_right[i]] = new_left[i];
+            }
+        }
+        swap_sides(_left, left);
+        swap_sides(_right, right);
+    }
+
+    // Упорядочивает значения batch стороны Side (order -- их номера по
+    // возрастанию) и разбивает их на классы равных: cls[i] -- класс
+    // значения i, taken[c] -- значение класса c уже есть во flat_bimap.
+    template <class Side, class Batch>
+    static void classify(Side const &side, Batch const &batch, bool sorted,
+                         std::vector<size_t> &order, std::vector<size_t> &cls,
+                         std::vector<char> &taken) {
+        auto const &less = side.comparator;
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        if (!sorted) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&](size_t a, size_t b) { return less(batch[a], batch[b]); });
+        }
+        for (size_t j = 0; j < order.size(); ++j) {
+            size_t i = order[j];
+            if (j > 0 && !less(batch[order[j - 1]], batch[i])) {
+                cls[i] = cls[order[j - 1]];
+                continue;
+            }
+            cls[i] = j;
+            taken[j] = side.find(batch[i]) != side.size();
+        }
+    }
+
+    // Позиции слияния элементов side с принятыми значениями batch: только
+    // сравнения, ни side, ни batch не меняются.
+    template <class Side, class Batch>
+    static void merge_positions(Side const &side, Batch const &batch,
+                                std::vector<size_t> const &order,
+                                std::vector<char> const &accepted,
+                                std::vector<index> &old_pos, std::vector<index> &new_pos) {
+        auto const &less = side.comparator;
+        index existing = 0;
+        index out = 0;
+        for (size_t i : order) {
+            if (!accepted[i]) {
+                continue;
+            }
+            while (existing != side.size() && less(side.values[existing], batch[i])) {
+                old_pos[existing++] = out++;
+            }
+            new_pos[i] = out++;
+        }
+        for (; existing != side.size(); ++existing) {
+            old_pos[existing] = out++;
+        }
+    }
+
+    // Раскладывает значения в out, память которого уже выделена, по
+    // позициям merge_positions, без сравнений. Элементы side переносятся,
+    // только если перенос не бросает, иначе копируются, так что при
+    // исключении side не меняется.
+    template <class Side, class Batch>
+    static void fill_side(Side &side, Batch &batch, std::vector<size_t> const &order,
+                          std::vector<char> const &accepted,
+                          std::vector<index> const &old_pos,
+                          std::vector<index> const &new_pos, Side &out) {
+        index existing = 0;
+        for (size_t i : order) {
+            if (!accepted[i]) {
+                continue;
+            }
+            while (existing != side.size() && old_pos[existing] < new_pos[i]) {
+                out.values.push_back(std::move_if_noexcept(side.values[existing++]));
+            }
+            out.values.push_back(std::move(batch[i]));
+        }
+        for (; existing != side.size(); ++existing) {
+            out.values.push_back(std::move_if_noexcept(side.values[existing]));
+        }
+    }
+
+    template <class Side> static void swap_sides(Side &a, Side &b) {
+        using std::swap;
+        a.values.swap(b.values);
+        a.other.swap(b.other);
+        swap(a.comparator, b.comparator);
+    }
+
+    left_side _left;
+    right_side _right;
+};
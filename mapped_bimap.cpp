@@ -0,0 +1,793 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Двоичный снимок bimap в файле, который открывается через mmap без
+// разбора: mapped_bimap за O(1) проверяет заголовок и дальше ищет прямо в
+// отображенной памяти, страницы подгружаются по мере обращения.
+// save_bimap пишет снимок любого bimap с упорядоченными сторонами
+// (bimap, flat_bimap, btree_bimap, compact_bimap), load_bimap строит из
+// снимка контейнер с конструктором от sorted_left и диапазона пар.
+//
+// Формат (порядок байт и выравнивание машины, которая писала файл):
+//   заголовок snapshot_header;
+//   секции, каждая с границы 64 байт:
+//     left_values, left_offsets, right_values, right_offsets,
+//     left_other, right_other.
+// Стороны устроены как во flat_bimap: значения по возрастанию компаратора
+// и массив other позиций парных элементов на другой стороне (uint32).
+// Значения с trivial_serializer лежат массивом T и отдаются ссылками в
+// отображение; с собственным сериализатором -- подряд байтами, а
+// offsets[i] (uint64, n + 1 штук) -- начало i-го значения, и отдаются
+// они копиями. Секции offsets у тривиальных сторон пустые.
+// Заголовок защищен своей контрольной суммой (проверяется при открытии),
+// секции -- общей (verify(), O(n)). Компаратор в файле не записан, и
+// проверить его при открытии нельзя: открывать снимок нужно с тем же
+// порядком, с каким он писался, иначе поиск в нем молча промахивается.
+
+// Сериализатор по умолчанию: значение хранится как есть.
+// Собственный сериализатор типа T задает
+//   static size_t size(T const &value);             -- размер в байтах,
+//   static void write(T const &value, char *out);   -- запись size() байт,
+//   static T read(char const *in, size_t size);     -- обратное чтение.
+template <class T> struct trivial_serializer {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "trivial_serializer requires a trivially copyable type, supply a serializer");
+    static_assert(alignof(T) <= 64, "snapshot sections are aligned to 64 bytes");
+};
+
+template <class Serializer> inline constexpr bool is_trivial_serializer_v = false;
+
+template <class T> inline constexpr bool is_trivial_serializer_v<trivial_serializer<T>> = true;
+
+inline constexpr std::uint32_t snapshot_version = 1;
+
+struct snapshot_header {
+    struct section {
+        std::uint64_t offset;
+        std::uint64_t size;
+    };
+
+    enum { left_values, left_offsets, right_values, right_offsets, left_other, right_other };
+    static constexpr size_t section_count = 6;
+
+    char magic[8];
+    std::uint32_t version;
+    // 0x01020304 в порядке байт писавшей машины.
+    std::uint32_t byte_order;
+    std::uint64_t count;
+    // Размер и выравнивание значения стороны, 0 -- собственный сериализатор.
+    std::uint32_t left_size;
+    std::uint32_t left_align;
+    std::uint32_t right_size;
+    std::uint32_t right_align;
+    section sections[section_count];
+    std::uint64_t payload_checksum;
+    // Сумма байт заголовка до этого поля.
+    std::uint64_t header_checksum;
+};
+
+static_assert(std::is_trivially_copyable_v<snapshot_header>);
+
+namespace snapshot_detail {
+
+inline constexpr char magic[8] = {'B', 'I', 'M', 'A', 'P', 'S', 'N', 'P'};
+inline constexpr std::uint32_t byte_order = 0x01020304;
+inline constexpr size_t alignment = 64;
+inline constexpr size_t header_size = (sizeof(snapshot_header) + alignment - 1) / alignment * alignment;
+
+inline size_t align_up(size_t n) { return (n + alignment - 1) / alignment * alignment; }
+
+// Контрольная сумма для поиска повреждений (не криптографическая): четыре
+// независимые цепочки раундов xxHash64 по 8 байт, так что скорость
+// ограничена памятью, а не задержкой умножения. Данные подаются кусками,
+// кратными 32 байтам.
+struct checksum {
+    static constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    static constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    static std::uint64_t rotl(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static std::uint64_t round(std::uint64_t lane, std::uint64_t word) {
+        return rotl(lane + word * prime2, 31) * prime1;
+    }
+
+    void update(char const *data, size_t size) {
+        for (size_t i = 0; i < size; i += 32) {
+            for (size_t j = 0; j < 4; ++j) {
+                std::uint64_t word;
+                std::memcpy(&word, data + i + 8 * j, 8);
+                lanes[j] = round(lanes[j], word);
+            }
+        }
+        length += size;
+    }
+
+    std::uint64_t finish() const {
+        std::uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) +
+                          rotl(lanes[3], 18) + length;
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        return h;
+    }
+
+    std::uint64_t lanes[4] = {prime1 + prime2, prime2, 0, 0 - prime1};
+    std::uint64_t length = 0;
+};
+
+inline std::uint64_t header_checksum(snapshot_header const &header) {
+    char bytes[(offsetof(snapshot_header, header_checksum) + 31) / 32 * 32]{};
+    std::memcpy(bytes, &header, offsetof(snapshot_header, header_checksum));
+    checksum sum;
+    sum.update(bytes, sizeof(bytes));
+    return sum.finish();
+}
+
+[[noreturn]] inline void throw_errno(char const *what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Буферизованная запись секций с подсчетом контрольной суммы. Буфер
+// сбрасывается целиком, а длина всех секций кратна 64, поэтому в сумму
+// идут куски, кратные 32 байтам.
+struct writer {
+    explicit writer(std::FILE *file) : file(file), buffer(size_t{1} << 16) {}
+
+    void put(void const *data, size_t size) {
+        auto const *bytes = static_cast<char const *>(data);
+        while (size != 0) {
+            size_t chunk = std::min(size, buffer.size() - used);
+            std::memcpy(buffer.data() + used, bytes, chunk);
+            used += chunk;
+            bytes += chunk;
+            size -= chunk;
+            if (used == buffer.size()) {
+                flush();
+            }
+        }
+    }
+
+    // Дополняет текущую секцию нулями до границы и возвращает ее место.
+    snapshot_header::section close_section() {
+        static constexpr char zeros[alignment]{};
+        put(zeros, align_up(position()) - position());
+        snapshot_header::section result{section_start, position() - section_start};
+        section_start = position();
+        return result;
+    }
+
+    size_t position() const { return written + used; }
+
+    void flush() {
+        sum.update(buffer.data(), used);
+        if (std::fwrite(buffer.data(), 1, used, file) != used) {
+            throw_errno("save_bimap: write failed");
+        }
+        written += used;
+        used = 0;
+    }
+
+    std::FILE *file;
+    std::vector<char> buffer;
+    size_t used = 0;
+    size_t written = header_size;
+    size_t section_start = header_size;
+    checksum sum;
+};
+
+// Пишет значения стороны в порядке обхода [first, last) и, для
+// собственного сериализатора, секцию их смещений.
+template <class Serializer, class It>
+void write_values(writer &out, It first, It last, snapshot_header::section &values,
+                  snapshot_header::section &offsets) {
+    if constexpr (is_trivial_serializer_v<Serializer>) {
+        for (; first != last; ++first) {
+            out.put(std::addressof(*first), sizeof(*first));
+        }
+        values = out.close_section();
+        offsets = out.close_section();
+    } else {
+        std::vector<std::uint64_t> starts{0};
+        std::vector<char> bytes;
+        for (; first != last; ++first) {
+            size_t size = Serializer::size(*first);
+            bytes.resize(size);
+            Serializer::write(*first, bytes.data());
+            out.put(bytes.data(), size);
+            starts.push_back(starts.back() + size);
+        }
+        values = out.close_section();
+        out.put(starts.data(), starts.size() * sizeof(std::uint64_t));
+        offsets = out.close_section();
+    }
+}
+
+template <class T, class Serializer> void describe(std::uint32_t &size, std::uint32_t &align) {
+    if constexpr (is_trivial_serializer_v<Serializer>) {
+        size = sizeof(T);
+        align = alignof(T);
+    } else {
+        size = 0;
+        align = 0;
+    }
+}
+
+// Обход сторон Map идет по порядку компаратора. У bimap с хешированной
+// стороной порядок обхода -- порядок таблицы, и бинарный поиск по такому
+// снимку промахивается.
+template <class Map, class = void> inline constexpr bool ordered_sides_v = true;
+
+template <class Map>
+inline constexpr bool ordered_sides_v<Map, std::void_t<decltype(Map::any_hashed)>> =
+        !Map::any_hashed;
+
+struct file_closer {
+    void operator()(std::FILE *file) const { std::fclose(file); }
+};
+
+} // namespace snapshot_detail
+
+// Записывает снимок map в path. Обе стороны map должны быть упорядочены;
+// компаратор в снимок не пишется, открывать его нужно с тем же порядком.
+// Файл пишется рядом под именем path.tmp и
+// переименовывается после fsync, так что читатели видят либо старый
+// снимок, либо новый целиком. Итераторы map должны отдавать ссылки на
+// значения, которые не двигаются во время записи. O(n log n): позиции
+// парных элементов находятся сортировкой адресов значений.
+// Ошибки ввода-вывода -- std::system_error, больше 2^32 - 1 пар --
+// std::length_error.
+template <class LeftSerializer = void, class RightSerializer = void, class Map>
+void save_bimap(Map const &map, std::string const &path) {
+    using left_t = typename Map::left_t;
+    using right_t = typename Map::right_t;
+    using left_serializer = std::conditional_t<std::is_void_v<LeftSerializer>,
+                                               trivial_serializer<left_t>, LeftSerializer>;
+    using right_serializer = std::conditional_t<std::is_void_v<RightSerializer>,
+                                                trivial_serializer<right_t>, RightSerializer>;
+    static_assert(std::is_reference_v<decltype(*map.begin_left())> &&
+                          std::is_reference_v<decltype(*map.begin_right())>,
+                  "save_bimap matches pairs by value addresses, iterators must return references");
+    static_assert(snapshot_detail::ordered_sides_v<Map>,
+                  "save_bimap requires ordered sides, a hashed side is written in hash order");
+    using index = std::uint32_t;
+    namespace detail = snapshot_detail;
+
+    size_t const n = map.size();
+    if (n >= UINT32_MAX) {
+        throw std::length_error{"save_bimap: too many pairs"};
+    }
+    // Адрес right каждой пары в порядке left и в порядке right: после
+    // сортировки по адресу k-е элементы обоих списков -- одна пара.
+    std::vector<index> left_other(n), right_other(n);
+    {
+        using tagged = std::pair<right_t const *, index>;
+        std::vector<tagged> by_left(n), by_right(n);
+        index i = 0;
+        for (auto it = map.begin_left(); it != map.end_left(); ++it, ++i) {
+            by_left[i] = {std::addressof(*it.flip()), i};
+        }
+        i = 0;
+        for (auto it = map.begin_right(); it != map.end_right(); ++it, ++i) {
+            by_right[i] = {std::addressof(*it), i};
+        }
+        auto by_address = [](tagged const &a, tagged const &b) {
+            return std::less<right_t const *>()(a.first, b.first);
+        };
+        std::sort(by_left.begin(), by_left.end(), by_address);
+        std::sort(by_right.begin(), by_right.end(), by_address);
+        for (size_t k = 0; k < n; ++k) {
+            left_other[by_left[k].second] = by_right[k].second;
+            right_other[by_right[k].second] = by_left[k].second;
+        }
+    }
+
+    std::string const temp = path + ".tmp";
+    std::unique_ptr<std::FILE, detail::file_closer> file(std::fopen(temp.c_str(), "wb"));
+    if (file == nullptr) {
+        detail::throw_errno("save_bimap: cannot create file");
+    }
+    try {
+        snapshot_header header{};
+        std::memcpy(header.magic, detail::magic, sizeof(header.magic));
+        header.version = snapshot_version;
+        header.byte_order = detail::byte_order;
+        header.count = n;
+        detail::describe<left_t, left_serializer>(header.left_size, header.left_align);
+        detail::describe<right_t, right_serializer>(header.right_size, header.right_align);
+
+        if (std::fseek(file.get(), static_cast<long>(detail::header_size), SEEK_SET) != 0) {
+            detail::throw_errno("save_bimap: seek failed");
+        }
+        detail::writer out(file.get());
+        auto *sections = header.sections;
+        detail::write_values<left_serializer>(out, map.begin_left(), map.end_left(),
+                                              sections[snapshot_header::left_values],
+                                              sections[snapshot_header::left_offsets]);
+        detail::write_values<right_serializer>(out, map.begin_right(), map.end_right(),
+                                               sections[snapshot_header::right_values],
+                                               sections[snapshot_header::right_offsets]);
+        out.put(left_other.data(), n * sizeof(index));
+        sections[snapshot_header::left_other] = out.close_section();
+        out.put(right_other.data(), n * sizeof(index));
+        sections[snapshot_header::right_other] = out.close_section();
+        out.flush();
+
+        header.payload_checksum = out.sum.finish();
+        header.header_checksum = detail::header_checksum(header);
+        char head[detail::header_size]{};
+        std::memcpy(head, &header, sizeof(header));
+        std::rewind(file.get());
+        if (std::fwrite(head, 1, sizeof(head), file.get()) != sizeof(head) ||
+            std::fflush(file.get()) != 0 || fsync(fileno(file.get())) != 0) {
+            detail::throw_errno("save_bimap: write failed");
+        }
+        if (std::fclose(file.release()) != 0) {
+            detail::throw_errno("save_bimap: close failed");
+        }
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            detail::throw_errno("save_bimap: rename failed");
+        }
+    } catch (...) {
+        file.reset();
+        std::remove(temp.c_str());
+        throw;
+    }
+}
+
+// Неизменяемый bimap поверх отображенного в память снимка. Открытие --
+// O(1): проверяются заголовок и границы секций, данные не читаются.
+// Интерфейс чтения -- как у flat_bimap: итератор -- позиция, flip() --
+// одно чтение из массива, поиск -- бинарный по массиву значений.
+// Содержимое секций при открытии не проверяется: файл из ненадежного
+// источника сначала проверяют verify() (load_bimap делает это сам).
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename LeftSerializer = trivial_serializer<Left>,
+          typename RightSerializer = trivial_serializer<Right>>
+struct mapped_bimap {
+    using left_t = Left;
+    using right_t = Right;
+    using index = std::uint32_t;
+
+private:
+    // Одна сторона: values (или bytes и offsets) по возрастанию, other[i]
+    // -- позиция парного элемента на другой стороне.
+    template <class T, class Serializer, class Compare> struct side {
+        static constexpr bool fixed = is_trivial_serializer_v<Serializer>;
+        using reference = std::conditional_t<fixed, T const &, T>;
+
+        reference value(index i) const {
+            if constexpr (fixed) {
+                return values[i];
+            } else {
+                return Serializer::read(bytes + offsets[i], offsets[i + 1] - offsets[i]);
+            }
+        }
+
+        // Бинарный поиск без ветвлений, как во flat_bimap. Заранее
+        // запрашиваются обе возможные середины следующего шага: для
+        // отображенного файла это и страницы, которые еще не загружены.
+        template <class K> index lower_bound(K const &key) const {
+            index base = 0;
+            size_t n = count;
+            if (n == 0) {
+                return 0;
+            }
+            while (n > 1) {
+                size_t half = n / 2;
+                prefetch(base + half / 2);
+                prefetch(base + half + half / 2);
+                base = comparator(value(base + half), key) ? base + half : base;
+                n -= half;
+            }
+            return base + comparator(value(base), key);
+        }
+
+        template <class K> index upper_bound(K const &key) const {
+            index base = 0;
+            size_t n = count;
+            if (n == 0) {
+                return 0;
+            }
+            while (n > 1) {
+                size_t half = n / 2;
+                prefetch(base + half / 2);
+                prefetch(base + half + half / 2);
+                base = comparator(key, value(base + half)) ? base : base + half;
+                n -= half;
+            }
+            return base + !comparator(key, value(base));
+        }
+
+        // Позиция key или count, если его нет.
+        template <class K> index find(K const &key) const {
+            index i = lower_bound(key);
+            return i != count && !comparator(key, value(i)) ? i : count;
+        }
+
+        void prefetch([[maybe_unused]] size_t i) const {
+#if defined(__GNUC__)
+            if constexpr (fixed) {
+                __builtin_prefetch(values + i);
+            } else {
+                __builtin_prefetch(offsets + i);
+            }
+#endif
+        }
+
+        T const *values{};
+        char const *bytes{};
+        std::uint64_t const *offsets{};
+        index const *other{};
+        index count{};
+        Compare comparator;
+    };
+
+    using left_side = side<Left, LeftSerializer, CompareLeft>;
+    using right_side = side<Right, RightSerializer, CompareRight>;
+
+public:
+    using left_reference = typename left_side::reference;
+    using right_reference = typename right_side::reference;
+
+    struct right_iterator;
+
+    struct left_iterator {
+        left_iterator(mapped_bimap const *map, index pos) : _map(map), _pos(pos) {}
+
+        // Разыменование end_left() и невалидного итератора неопределено.
+        left_reference operator*() const { return _map->_left.value(_pos); }
+
+        left_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+
+        left_iterator operator++(int) {
+            left_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        left_iterator &operator--() {
+            --_pos;
+            return *this;
+        }
+
+        left_iterator operator--(int) {
+            left_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        // Итератор на right той же пары, end_left().flip() -- end_right().
+        right_iterator flip() const {
+            return right_iterator{_map, _pos == _map->_left.count ? _pos
+                                                                  : _map->_left.other[_pos]};
+        }
+
+        [[nodiscard]] bool operator==(left_iterator it) const { return _pos == it._pos; }
+        [[nodiscard]] bool operator!=(left_iterator it) const { return !(*this == it); }
+
+        mapped_bimap const *_map;
+        index _pos;
+    };
+
+    struct right_iterator {
+        right_iterator(mapped_bimap const *map, index pos) : _map(map), _pos(pos) {}
+
+        right_reference operator*() const { return _map->_right.value(_pos); }
+
+        right_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+
+        right_iterator operator++(int) {
+            right_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        right_iterator &operator--() {
+            --_pos;
+            return *this;
+        }
+
+        right_iterator operator--(int) {
+            right_iterator temp{*this};
+            --*this;
+            return temp;
+        }
+
+        left_iterator flip() const {
+            return left_iterator{_map, _pos == _map->_right.count ? _pos
+                                                                  : _map->_right.other[_pos]};
+        }
+
+        [[nodiscard]] bool operator==(right_iterator it) const { return _pos == it._pos; }
+        [[nodiscard]] bool operator!=(right_iterator it) const { return !(*this == it); }
+
+        mapped_bimap const *_map;
+        index _pos;
+    };
+
+    // Пары по порядку left как std::pair<Left, Right> (копии): вход для
+    // конструкторов и insert_range(sorted_left, ...) контейнеров.
+    // Однонаправленный итератор-прокси: разыменование отдает значение, а
+    // operator- -- расстояние за O(1) сверх требований категории.
+    struct pair_iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<Left, Right>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        pair_iterator() = default;
+        pair_iterator(mapped_bimap const *map, index pos) : _map(map), _pos(pos) {}
+
+        value_type operator*() const {
+            left_iterator it{_map, _pos};
+            return value_type(*it, *it.flip());
+        }
+
+        pair_iterator &operator++() {
+            ++_pos;
+            return *this;
+        }
+
+        pair_iterator operator++(int) {
+            pair_iterator temp{*this};
+            ++*this;
+            return temp;
+        }
+
+        difference_type operator-(pair_iterator it) const {
+            return static_cast<difference_type>(_pos) - static_cast<difference_type>(it._pos);
+        }
+
+        [[nodiscard]] bool operator==(pair_iterator it) const { return _pos == it._pos; }
+        [[nodiscard]] bool operator!=(pair_iterator it) const { return !(*this == it); }
+
+        mapped_bimap const *_map{};
+        index _pos{};
+    };
+
+    // Отображает снимок path. Ошибки открытия -- std::system_error,
+    // неподходящий или поврежденный заголовок -- std::runtime_error.
+    explicit mapped_bimap(std::string const &path, CompareLeft compare_left = CompareLeft(),
+                          CompareRight compare_right = CompareRight()) {
+        _left.comparator = compare_left;
+        _right.comparator = compare_right;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            snapshot_detail::throw_errno("mapped_bimap: cannot open file");
+        }
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "mapped_bimap: stat failed");
+        }
+        _size = static_cast<size_t>(info.st_size);
+        if (_size < snapshot_detail::header_size) {
+            ::close(fd);
+            throw std::runtime_error{"mapped_bimap: file too small"};
+        }
+        void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        int error = errno;
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mapped_bimap: mmap failed");
+        }
+        _data = static_cast<char const *>(data);
+        try {
+            attach();
+        } catch (...) {
+            munmap(const_cast<char *>(_data), _size);
+            throw;
+        }
+    }
+
+    mapped_bimap(mapped_bimap &&other) noexcept
+            : _left(other._left), _right(other._right), _header(other._header),
+              _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)) {
+        other._left.count = other._right.count = 0;
+    }
+
+    mapped_bimap &operator=(mapped_bimap &&other) noexcept {
+        if (this != &other) {
+            mapped_bimap temp(std::move(other));
+            swap(temp);
+        }
+        return *this;
+    }
+
+    mapped_bimap(mapped_bimap const &) = delete;
+    mapped_bimap &operator=(mapped_bimap const &) = delete;
+
+    ~mapped_bimap() {
+        if (_data != nullptr) {
+            munmap(const_cast<char *>(_data), _size);
+        }
+    }
+
+    void swap(mapped_bimap &other) noexcept {
+        std::swap(_left, other._left);
+        std::swap(_right, other._right);
+        std::swap(_header, other._header);
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+
+    friend void swap(mapped_bimap &a, mapped_bimap &b) noexcept { a.swap(b); }
+
+    // Сверяет контрольную сумму секций: читает весь файл.
+    bool verify() const {
+        snapshot_detail::checksum sum;
+        sum.update(_data + snapshot_detail::header_size, _size - snapshot_detail::header_size);
+        return sum.finish() == _header.payload_checksum;
+    }
+
+    // Возвращает итератор по элементу. Если не найден - соответствующий end()
+    template <class K> left_iterator find_left(K const &left) const {
+        return left_iterator{this, _left.find(left)};
+    }
+
+    template <class K> right_iterator find_right(K const &right) const {
+        return right_iterator{this, _right.find(right)};
+    }
+
+    // Возвращает противоположный элемент по элементу
+    // Если элемента не существует -- бросает std::out_of_range
+    template <class K> right_reference at_left(K const &key) const {
+        index i = _left.find(key);
+        if (i == _left.count) {
+            throw std::out_of_range{"mapped_bimap: no such left"};
+        }
+        return _right.value(_left.other[i]);
+    }
+
+    template <class K> left_reference at_right(K const &key) const {
+        index i = _right.find(key);
+        if (i == _right.count) {
+            throw std::out_of_range{"mapped_bimap: no such right"};
+        }
+        return _left.value(_right.other[i]);
+    }
+
+    template <class K> left_iterator lower_bound_left(K const &left) const {
+        return left_iterator{this, _left.lower_bound(left)};
+    }
+
+    template <class K> left_iterator upper_bound_left(K const &left) const {
+        return left_iterator{this, _left.upper_bound(left)};
+    }
+
+    template <class K> right_iterator lower_bound_right(K const &right) const {
+        return right_iterator{this, _right.lower_bound(right)};
+    }
+
+    template <class K> right_iterator upper_bound_right(K const &right) const {
+        return right_iterator{this, _right.upper_bound(right)};
+    }
+
+    left_iterator begin_left() const { return left_iterator{this, 0}; }
+    left_iterator end_left() const { return left_iterator{this, _left.count}; }
+
+    right_iterator begin_right() const { return right_iterator{this, 0}; }
+    right_iterator end_right() const { return right_iterator{this, _right.count}; }
+
+    pair_iterator begin_pairs() const { return pair_iterator{this, 0}; }
+    pair_iterator end_pairs() const { return pair_iterator{this, _left.count}; }
+
+    bool empty() const { return size() == 0; }
+
+    std::size_t size() const { return _left.count; }
+
+    snapshot_header const &header() const { return _header; }
+
+private:
+    using header_t = snapshot_header;
+
+    // Разбирает заголовок и ставит указатели сторон на секции.
+    void attach() {
+        namespace detail = snapshot_detail;
+        std::memcpy(&_header, _data, sizeof(_header));
+        if (std::memcmp(_header.magic, detail::magic, sizeof(_header.magic)) != 0) {
+            throw std::runtime_error{"mapped_bimap: not a bimap snapshot"};
+        }
+        if (_header.version != snapshot_version) {
+            throw std::runtime_error{"mapped_bimap: unsupported snapshot version"};
+        }
+        if (_header.byte_order != detail::byte_order) {
+            throw std::runtime_error{"mapped_bimap: snapshot has foreign byte order"};
+        }
+        if (_header.header_checksum != detail::header_checksum(_header)) {
+            throw std::runtime_error{"mapped_bimap: corrupted snapshot header"};
+        }
+        std::uint32_t left_size, left_align, right_size, right_align;
+        detail::describe<Left, LeftSerializer>(left_size, left_align);
+        detail::describe<Right, RightSerializer>(right_size, right_align);
+        if (_header.left_size != left_size || _header.left_align != left_align ||
+            _header.right_size != right_size || _header.right_align != right_align) {
+            throw std::runtime_error{"mapped_bimap: snapshot value types do not match"};
+        }
+        if (_header.count >= UINT32_MAX) {
+            throw std::runtime_error{"mapped_bimap: corrupted snapshot header"};
+        }
+        auto const n = static_cast<index>(_header.count);
+        _left.count = _right.count = n;
+        attach_side(_left, header_t::left_values, header_t::left_offsets, header_t::left_other);
+        attach_side(_right, header_t::right_values, header_t::right_offsets,
+                    header_t::right_other);
+    }
+
+    // Начало секции после проверки ее границ и минимального размера.
+    char const *section(size_t which, std::uint64_t min_size) const {
+        auto const &s = _header.sections[which];
+        if (s.offset % snapshot_detail::alignment != 0 || s.offset > _size ||
+            s.size > _size - s.offset || s.size < min_size) {
+            throw std::runtime_error{"mapped_bimap: corrupted snapshot header"};
+        }
+        return _data + s.offset;
+    }
+
+    template <class Side>
+    void attach_side(Side &side, size_t values, size_t offsets, size_t other) {
+        using T = std::remove_cv_t<std::remove_reference_t<typename Side::reference>>;
+        std::uint64_t const n = side.count;
+        if constexpr (Side::fixed) {
+            side.values = reinterpret_cast<T const *>(section(values, n * sizeof(T)));
+        } else {
+            side.bytes = section(values, 0);
+            side.offsets = reinterpret_cast<std::uint64_t const *>(
+                    section(offsets, (n + 1) * sizeof(std::uint64_t)));
+        }
+        side.other = reinterpret_cast<index const *>(section(other, n * sizeof(index)));
+    }
+
+    left_side _left;
+    right_side _right;
+    snapshot_header _header{};
+    char const *_data{};
+    size_t _size{};
+};
+
+// Строит контейнер Map (bimap, flat_bimap, btree_bimap, compact_bimap)
+// из снимка path через его конструктор Map(sorted_left, first, last),
+// сверив контрольную сумму (std::runtime_error при несовпадении). Пары
+// идут по возрастанию left, поэтому bimap и flat_bimap сортируют только
+// правую сторону.
+template <class Map, class LeftSerializer = trivial_serializer<typename Map::left_t>,
+          class RightSerializer = trivial_serializer<typename Map::right_t>>
+Map load_bimap(std::string const &path) {
+    mapped_bimap<typename Map::left_t, typename Map::right_t, std::less<typename Map::left_t>,
+                 std::less<typename Map::right_t>, LeftSerializer, RightSerializer>
+            snapshot(path);
+    if (!snapshot.verify()) {
+        throw std::runtime_error{"load_bimap: snapshot checksum mismatch"};
+    }
+    return Map(sorted_left, snapshot.begin_pairs(), snapshot.end_pairs());
+}
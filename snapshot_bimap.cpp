@@ -0,0 +1,152 @@
+#pragma once
+
+#include "bimap.cpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// bimap со снимками для читателей, которые не должны ждать писателя.
+// snapshot() за O(1) отдает std::shared_ptr на неизменяемый bimap: его
+// можно обходить от begin_left() до end_left() сколько угодно долго, пока
+// писатель меняет свою копию. Изменения становятся видны новым снимкам
+// после publish().
+// Экземпляров два: опубликованный (только для чтения) и рабочая копия
+// писателя. При publish() они меняются ролями, а бывший опубликованный,
+// если его уже не держит ни один читатель, догоняется повтором журнала
+// операций с прошлой публикации -- O(k) на k изменений вместо копирования
+// всего bimap. Если снимок еще держат, рабочая копия создается
+// копированием при первой записи после публикации.
+// Читатели не берут блокировок bimap; snapshot() -- std::atomic_load на
+// shared_ptr (в libstdc++ под ним короткая спин-блокировка из общего пула).
+// Записи и publish() сериализуются внутренним mutex.
+template <typename Left, typename Right, typename CompareLeft = std::less<Left>,
+          typename CompareRight = std::less<Right>,
+          typename Allocator = std::allocator<std::pair<Left, Right>>,
+          typename... Policies>
+struct snapshot_bimap {
+    using bimap_type = bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>;
+    using snapshot_type = std::shared_ptr<bimap_type const>;
+    using left_t = Left;
+    using right_t = Right;
+
+    explicit snapshot_bimap(bimap_type initial = bimap_type())
+            : _shared(std::make_shared<bimap_type>(std::move(initial))),
+              _published(_shared) {}
+
+    snapshot_bimap(snapshot_bimap const &) = delete;
+    snapshot_bimap &operator=(snapshot_bimap const &) = delete;
+
+    // Последняя опубликованная версия. Можно вызывать из любого потока.
+    snapshot_type snapshot() const { return std::atomic_load(&_published); }
+
+    // Изменения рабочей копии, результат как у соответствующих методов
+    // bimap. Видны в snapshot() только после publish().
+    bool insert(left_t const &left, right_t const &right) {
+        return apply(insert_op{left, right}, [&](bimap_type &b) {
+            return b.insert(left, right) != b.end_left();
+        });
+    }
+
+    bool erase_left(left_t const &left) {
+        return apply(erase_left_op{left}, [&](bimap_type &b) { return b.erase_left(left); });
+    }
+
+    bool erase_right(right_t const &right) {
+        return apply(erase_right_op{right},
+                     [&](bimap_type &b) { return b.erase_right(right); });
+    }
+
+    // Рабочая копия для чтения писателем. Ссылка действительна до
+    // следующего изменения или publish(); одновременно с другими
+    // писателями не вызывать.
+    bimap_type const &working() const { return _working != nullptr ? *_working : *_shared; }
+
+    // Делает изменения видимыми новым снимкам. Уже выданные снимки не
+    // меняются. Без изменений с прошлой публикации ничего не делает.
+    void publish() {
+        std::lock_guard lock(_write_mutex);
+        if (_log.empty()) {
+            return;
+        }
+        std::shared_ptr<bimap_type> retired = std::exchange(_shared, std::move(_working));
+        std::atomic_store(&_published, snapshot_type(_shared));
+        // После замены _published новых ссылок на retired не появляется:
+        // если она последняя, читатели закончили с ним, и acquire-барьер
+        // упорядочивает их чтения перед повтором журнала.
+        if (retired.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            try {
+                replay(*retired);
+                _working = std::move(retired);
+            } catch (...) {
+                // Рабочая копия будет скопирована при следующей записи.
+            }
+        }
+        _log.clear();
+    }
+
+private:
+    struct insert_op {
+        left_t left;
+        right_t right;
+    };
+
+    struct erase_left_op {
+        left_t left;
+    };
+
+    struct erase_right_op {
+        right_t right;
+    };
+
+    using operation = std::variant<insert_op, erase_left_op, erase_right_op>;
+
+    // Рабочая копия, создаваемая копированием опубликованной, если
+    // бывший опубликованный экземпляр при публикации еще читали.
+    bimap_type &working_instance() {
+        if (_working == nullptr) {
+            _working = std::make_shared<bimap_type>(*_shared);
+        }
+        return *_working;
+    }
+
+    // Запись в журнал готовится до изменения (копия значений и место в
+    // журнале), поэтому успешная операция всегда попадает в журнал, а
+    // исключение оставляет все как было.
+    template <class Op, class F> bool apply(Op op, F change) {
+        std::lock_guard lock(_write_mutex);
+        bimap_type &target = working_instance();
+        if (_log.size() == _log.capacity()) {
+            _log.reserve(2 * _log.size() + 1);
+        }
+        if (!change(target)) {
+            return false;
+        }
+        _log.emplace_back(std::move(op));
+        return true;
+    }
+
+    void replay(bimap_type &target) const {
+        for (operation const &op : _log) {
+            if (auto const *ins = std::get_if<insert_op>(&op)) {
+                target.insert(ins->left, ins->right);
+            } else if (auto const *el = std::get_if<erase_left_op>(&op)) {
+                target.erase_left(el->left);
+            } else {
+                target.erase_right(std::get<erase_right_op>(op).right);
+            }
+        }
+    }
+
+    std::mutex _write_mutex;
+    // Опубликованный экземпляр со стороны писателя (неконстантный, чтобы
+    // после ухода читателей переиспользовать его как рабочую копию).
+    std::shared_ptr<bimap_type> _shared;
+    std::shared_ptr<bimap_type> _working;
+    snapshot_type _published;
+    std::vector<operation> _log;
+};
@@ -0,0 +1,440 @@
+// Набор бенчмарков bimap: операции x нагрузки x размеры, базовая линия --
+// пара std::map. Каждый случай (контейнер, нагрузка, размер) выполняется в
+// отдельном процессе, поэтому пиковый RSS относится только к нему.
+//
+//   bimap_suite [--min N] [--max N] [--workload имя] [--container имя]
+//
+// Размеры -- степени десяти от --min (1e3) до --max (1e6 по умолчанию).
+// Пиковый RSS при n = 1e6 -- около 165 МиБ для bimap и 190 МиБ для пары
+// std::map, так что 1e8 требует порядка 16-20 ГиБ памяти.
+// Циклы поиска ограничены по времени (см. measure_loop).
+
+#include "bimap.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <random>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// Счетчик вызовов глобального operator new: аллокации на операцию.
+size_t allocation_count = 0;
+
+// Все формы operator new/delete идут через одну пару malloc/free, иначе
+// выровненные и nothrow-аллокации не попадают в счетчик, а смешение форм
+// дает -Wmismatched-new-delete. aligned_alloc освобождается через free.
+void *counted_allocate(size_t size, size_t alignment) noexcept {
+    ++allocation_count;
+    if (size == 0) {
+        size = 1;
+    }
+    if (alignment <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void *counted_allocate_or_throw(size_t size, size_t alignment) {
+    if (void *p = counted_allocate(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+    return counted_allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size) {
+    return counted_allocate_or_throw(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return counted_allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return counted_allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+    return counted_allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+    return counted_allocate(size, alignof(std::max_align_t));
+}
+
+void *operator new(size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept {
+    return counted_allocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete[](void *p, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t, std::nothrow_t const &) noexcept { std::free(p); }
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using key_type = std::uint32_t;
+
+// right пары -- биекция left на 32-битных числах, отдельный массив не нужен.
+key_type right_of(key_type left) { return left * 2654435761u; }
+
+// Интерфейс случая для bimap: одинаковые операции для всех контейнеров.
+template <class Bimap> struct bimap_case {
+    bool insert(key_type left, key_type right) {
+        return pairs.insert(left, right) != pairs.end_left();
+    }
+
+    bool find_left(key_type left) const { return pairs.find_left(left) != pairs.end_left(); }
+
+    bool find_right(key_type right) const {
+        return pairs.find_right(right) != pairs.end_right();
+    }
+
+    key_type at_left_or_default(key_type left) { return pairs.at_left_or_default(left); }
+
+    std::uint64_t scan() const {
+        std::uint64_t total = 0;
+        for (auto it = pairs.begin_left(); it != pairs.end_left(); ++it) {
+            total += *it;
+        }
+        for (auto it = pairs.begin_right(); it != pairs.end_right(); ++it) {
+            total += *it;
+        }
+        return total;
+    }
+
+    void erase_left_range(key_type from, key_type to) {
+        pairs.erase_left(pairs.lower_bound_left(from), pairs.lower_bound_left(to));
+    }
+
+    Bimap pairs;
+};
+
+// Базовая линия: два std::map, left -> right и right -> left.
+struct map_pair_case {
+    bool insert(key_type left, key_type right) {
+        if (by_left.count(left) != 0 || by_right.count(right) != 0) {
+            return false;
+        }
+        by_left.emplace(left, right);
+        by_right.emplace(right, left);
+        return true;
+    }
+
+    bool find_left(key_type left) const { return by_left.find(left) != by_left.end(); }
+
+    bool find_right(key_type right) const { return by_right.find(right) != by_right.end(); }
+
+    // Семантика bimap::at_left_or_default: пара с right по умолчанию
+    // переходит к left.
+    key_type at_left_or_default(key_type left) {
+        auto it = by_left.find(left);
+        if (it != by_left.end()) {
+            return it->second;
+        }
+        key_type const right{};
+        auto owner = by_right.find(right);
+        if (owner != by_right.end()) {
+            by_left.erase(owner->second);
+            owner->second = left;
+        } else {
+            by_right.emplace(right, left);
+        }
+        by_left.emplace(left, right);
+        return right;
+    }
+
+    std::uint64_t scan() const {
+        std::uint64_t total = 0;
+        for (auto const &p : by_left) {
+            total += p.first;
+        }
+        for (auto const &p : by_right) {
+            total += p.first;
+        }
+        return total;
+    }
+
+    void erase_left_range(key_type from, key_type to) {
+        auto first = by_left.lower_bound(from);
+        auto last = by_left.lower_bound(to);
+        for (auto it = first; it != last; ++it) {
+            by_right.erase(it->second);
+        }
+        by_left.erase(first, last);
+    }
+
+    std::map<key_type, key_type> by_left;
+    std::map<key_type, key_type> by_right;
+};
+
+// Порядок ключей нагрузки: вставка и поиск.
+// uniform     -- вставка и поиск в случайном порядке;
+// sequential  -- по возрастанию;
+// zipf        -- случайная вставка, поиск по закону Ципфа (s = 1);
+// adversarial -- вставка по возрастанию (в splay-дереве -- цепочка),
+//                поиск в бит-реверсном порядке, без локальности.
+struct workload {
+    char const *name;
+    bool shuffled_insert;
+    int lookup;
+};
+
+enum lookup_kind { lookup_uniform, lookup_sequential, lookup_zipf, lookup_bit_reversed };
+
+workload const workloads[] = {
+        {"uniform", true, lookup_uniform},
+        {"sequential", false, lookup_sequential},
+        {"zipf", true, lookup_zipf},
+        {"adversarial", false, lookup_bit_reversed},
+};
+
+std::vector<key_type> insert_order(size_t n, workload const &w, std::mt19937_64 &rng) {
+    std::vector<key_type> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = static_cast<key_type>(i);
+    }
+    if (w.shuffled_insert) {
+        std::shuffle(keys.begin(), keys.end(), rng);
+    }
+    return keys;
+}
+
+// m ключей поиска, все из [0, n).
+std::vector<key_type> lookup_order(size_t n, size_t m, workload const &w,
+                                   std::vector<key_type> const &inserted,
+                                   std::mt19937_64 &rng) {
+    std::vector<key_type> keys(m);
+    switch (w.lookup) {
+    case lookup_uniform:
+        for (auto &k : keys) {
+            k = static_cast<key_type>(rng() % n);
+        }
+        break;
+    case lookup_sequential:
+        for (size_t i = 0; i < m; ++i) {
+            keys[i] = static_cast<key_type>(i * (n / m));
+        }
+        break;
+    case lookup_zipf: {
+        // Приближенная выборка ранга r с вероятностью ~ 1 / (r + 1):
+        // обращение ln(r + 1) ~ H(r). Без таблицы на n элементов.
+        std::uniform_real_distribution<double> uniform(0, std::log(static_cast<double>(n) + 1));
+        for (auto &k : keys) {
+            auto rank = static_cast<size_t>(std::exp(uniform(rng))) - 1;
+            k = inserted[std::min(rank, n - 1)];
+        }
+        break;
+    }
+    default: {
+        unsigned bits = 0;
+        while ((size_t{1} << bits) < n) {
+            ++bits;
+        }
+        size_t i = 0;
+        for (size_t x = 0; i < m; ++x) {
+            size_t reversed = 0;
+            for (unsigned b = 0; b < bits; ++b) {
+                reversed |= ((x >> b) & 1) << (bits - 1 - b);
+            }
+            if (reversed < n) {
+                keys[i++] = static_cast<key_type>(reversed);
+            }
+        }
+        break;
+    }
+    }
+    return keys;
+}
+
+struct measurement {
+    double ns;
+    size_t allocations;
+    size_t ops;
+    bool partial;
+};
+
+template <class F> measurement measure(size_t ops, F &&f) {
+    size_t const allocations = allocation_count;
+    auto start = clock_type::now();
+    f();
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+    return {ns, allocation_count - allocations, ops, false};
+}
+
+// Цикл поиска с ограничением по времени: на вырожденных нагрузках (splay-
+// дерево-цепочка) полный проход занял бы часы. Время проверяется раз в
+// 1024 итерации, в отчет идет число выполненных операций.
+constexpr std::chrono::seconds loop_budget{2};
+
+template <class F> measurement measure_loop(size_t count, F &&body) {
+    size_t const allocations = allocation_count;
+    auto start = clock_type::now();
+    size_t i = 0;
+    while (i < count) {
+        size_t const stop = std::min(count, i + 1024);
+        for (; i < stop; ++i) {
+            body(i);
+        }
+        if (clock_type::now() - start > loop_budget) {
+            break;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+    return {ns, allocation_count - allocations, i, i < count};
+}
+
+void report(char const *container, char const *load, size_t n, char const *op,
+            measurement m) {
+    std::printf("%-20s %-12s n=%-10zu %-20s %10.1f ns/op %8.3f allocs/op%s\n", container, load,
+                n, op, m.ns / static_cast<double>(m.ops),
+                static_cast<double>(m.allocations) / static_cast<double>(m.ops),
+                m.partial ? "  (time budget, partial)" : "");
+}
+
+template <class Case> void run_case(char const *container, workload const &w, size_t n) {
+    std::mt19937_64 rng(61);
+    std::vector<key_type> keys = insert_order(n, w, rng);
+    size_t const m = std::min<size_t>(n, size_t{1} << 20);
+    std::vector<key_type> lookups = lookup_order(n, m, w, keys, rng);
+    std::uint64_t total = 0;
+    auto out = [&](char const *op, measurement r) { report(container, w.name, n, op, r); };
+
+    auto *c = new Case;
+    out("insert", measure(n, [&] {
+            for (key_type k : keys) {
+                total += c->insert(k, right_of(k));
+            }
+        }));
+    out("find_left", measure_loop(m, [&](size_t i) { total += c->find_left(lookups[i]); }));
+    out("find_right",
+        measure_loop(m, [&](size_t i) { total += c->find_right(right_of(lookups[i])); }));
+    // Половина обращений -- к отсутствующим ключам. Пара с right по
+    // умолчанию есть всегда (right_of(0) == 0), промах переносит ее на новый
+    // left, и размер остается n.
+    out("at_left_or_default", measure_loop(m, [&](size_t i) {
+            total += c->at_left_or_default(i % 2 == 0 ? lookups[i]
+                                                      : static_cast<key_type>(n + i));
+        }));
+    size_t const size = n;
+    out("iterate (per elem)", measure(2 * size, [&] { total += c->scan(); }));
+    Case *copy = nullptr;
+    out("copy (per pair)", measure(size, [&] { copy = new Case(*c); }));
+    out("destroy (per pair)", measure(size, [&] { delete copy; }));
+    auto const from = static_cast<key_type>(n / 4);
+    auto const to = static_cast<key_type>(3 * n / 4);
+    out("range erase", measure(to - from, [&] { c->erase_left_range(from, to); }));
+    delete c;
+    if (total == 0) {
+        std::printf("unreachable\n");
+    }
+}
+
+struct options {
+    size_t min_size = 1000;
+    size_t max_size = 1000000;
+    char const *workload = nullptr;
+    char const *container = nullptr;
+};
+
+bool selected(char const *filter, char const *name) {
+    return filter == nullptr || std::strcmp(filter, name) == 0;
+}
+
+// Запускает случай в дочернем процессе и печатает его пиковый RSS.
+template <class Case>
+void run_isolated(options const &opt, char const *container, workload const &w, size_t n) {
+    if (!selected(opt.container, container) || !selected(opt.workload, w.name)) {
+        return;
+    }
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        std::perror("fork");
+        std::exit(1);
+    }
+    if (child == 0) {
+        run_case<Case>(container, w, n);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    rusage usage{};
+    wait4(child, &status, 0, &usage);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::printf("%-20s %-12s n=%-10zu failed (status %d)\n", container, w.name, n, status);
+        return;
+    }
+    std::printf("%-20s %-12s n=%-10zu %-20s %10.1f MiB\n", container, w.name, n, "peak RSS",
+                static_cast<double>(usage.ru_maxrss) / 1024);
+}
+
+options parse(int argc, char **argv) {
+    options opt;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::strcmp(argv[i], "--min") == 0) {
+            opt.min_size = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max") == 0) {
+            opt.max_size = std::strtoull(argv[i + 1], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--workload") == 0) {
+            opt.workload = argv[i + 1];
+        } else if (std::strcmp(argv[i], "--container") == 0) {
+            opt.container = argv[i + 1];
+        } else {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            std::exit(2);
+        }
+    }
+    return opt;
+}
+
+using allocator = std::allocator<std::pair<key_type, key_type>>;
+using less = std::less<key_type>;
+
+} // namespace
+
+int main(int argc, char **argv) {
+    options const opt = parse(argc, argv);
+    for (size_t n = opt.min_size; n <= opt.max_size; n *= 10) {
+        for (workload const &w : workloads) {
+            run_isolated<map_pair_case>(opt, "std::map pair", w, n);
+            run_isolated<bimap_case<bimap<key_type, key_type>>>(opt, "bimap splay", w, n);
+            run_isolated<bimap_case<bimap<key_type, key_type, less, less, allocator, red_black>>>(
+                    opt, "bimap red_black", w, n);
+            run_isolated<bimap_case<
+                    bimap<key_type, key_type, less, less, allocator, red_black, threaded>>>(
+                    opt, "bimap rb+threaded", w, n);
+        }
+    }
+}
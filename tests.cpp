@@ -0,0 +1,1308 @@
+// Тесты контейнеров против пары std::map: случайные вставки и удаления,
+// после каждой серии содержимое сравнивается с эталоном целиком (обе
+// стороны, порядок, поиск, копия). Отдельно -- контейнеры на
+// std::pmr::polymorphic_allocator с разными ресурсами, бросающие
+// компараторы и бросающий аллокатор: после исключения содержимое должно
+// совпадать с эталоном до операции. Снимки mapped_bimap.cpp пишутся во
+// временный каталог, читаются обратно и портятся по одному полю.
+//
+//   bimap_tests
+//
+// Код возврата ненулевой, если хоть одна проверка не прошла.
+
+#include "bimap.cpp"
+#include "btree_bimap.cpp"
+#include "compact_bimap.cpp"
+#include "concurrent_bimap.cpp"
+#include "flat_bimap.cpp"
+#include "mapped_bimap.cpp"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void expect(bool ok, char const *container, char const *what) {
+    if (!ok) {
+        std::printf("FAIL %s: %s\n", container, what);
+        ++failures;
+    }
+}
+
+// Ключи: int как есть, std::string -- длинные, чтобы не попадать в SSO и
+// выделять память при копировании.
+template <class T> T make_key(unsigned x) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        std::string s = std::to_string(x);
+        return std::string(24 - s.size(), 'k') + s;
+    } else {
+        return static_cast<T>(x);
+    }
+}
+
+// Эталон: пара std::map с той же семантикой вставки, что у bimap.
+template <class Left, class Right> struct reference {
+    bool insert(Left const &left, Right const &right) {
+        if (left_to_right.count(left) != 0 || right_to_left.count(right) != 0) {
+            return false;
+        }
+        left_to_right.emplace(left, right);
+        right_to_left.emplace(right, left);
+        return true;
+    }
+
+    bool erase_left(Left const &left) {
+        auto it = left_to_right.find(left);
+        if (it == left_to_right.end()) {
+            return false;
+        }
+        right_to_left.erase(it->second);
+        left_to_right.erase(it);
+        return true;
+    }
+
+    bool erase_right(Right const &right) {
+        auto it = right_to_left.find(right);
+        if (it == right_to_left.end()) {
+            return false;
+        }
+        left_to_right.erase(it->second);
+        right_to_left.erase(it);
+        return true;
+    }
+
+    std::map<Left, Right> left_to_right;
+    std::map<Right, Left> right_to_left;
+};
+
+// Хешированные стороны bimap: их обход идет в порядке таблицы, а
+// lower_bound_* нет.
+template <class Map> struct hashed_sides {
+    static constexpr bool left = false;
+    static constexpr bool right = false;
+};
+
+template <class Left, class Right, class CompareLeft, class CompareRight, class Allocator,
+          class... Policies>
+struct hashed_sides<bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>> {
+    using map_type = bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>;
+    static constexpr bool left = map_type::left_hashed;
+    static constexpr bool right = map_type::right_hashed;
+};
+
+// Сторона [first, last) против стороны эталона side: упорядоченная -- в
+// том же порядке, хешированная -- каждый элемент ищется в эталоне.
+// at(key) -- значение другой стороны по ключу.
+template <bool hashed, class It, class Side, class At>
+bool same_side(It first, It last, Side const &side, At at) {
+    size_t seen = 0;
+    auto next = side.begin();
+    for (auto it = first; it != last; ++it, ++seen) {
+        auto expected = next;
+        if constexpr (hashed) {
+            expected = side.find(*it);
+        } else if (next != side.end()) {
+            ++next;
+        }
+        if (expected == side.end() || !(*it == expected->first) ||
+            !(*it.flip() == expected->second)) {
+            return false;
+        }
+    }
+    if (seen != side.size()) {
+        return false;
+    }
+    for (auto const &[key, value] : side) {
+        if (!(at(key) == value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Полное сравнение контейнера с эталоном.
+template <class Map, class Left, class Right>
+void compare(Map const &map, reference<Left, Right> const &ref, char const *name) {
+    expect(map.size() == ref.left_to_right.size(), name, "size");
+    expect(same_side<hashed_sides<Map>::left>(map.begin_left(), map.end_left(),
+                                              ref.left_to_right,
+                                              [&](Left const &key) { return map.at_left(key); }),
+           name, "left side differs from std::map");
+    expect(same_side<hashed_sides<Map>::right>(map.begin_right(), map.end_right(),
+                                               ref.right_to_left,
+                                               [&](Right const &key) { return map.at_right(key); }),
+           name, "right side differs from std::map");
+}
+
+// Есть ли у Map порядковые статистики (bimap с политикой order_statistics).
+template <class Map> struct with_order_statistics : std::false_type {};
+
+template <class Left, class Right, class CompareLeft, class CompareRight, class Allocator,
+          class... Policies>
+struct with_order_statistics<bimap<Left, Right, CompareLeft, CompareRight, Allocator, Policies...>>
+        : std::bool_constant<has_policy_v<order_statistics, Policies...>> {};
+
+// nth_left, rank_left и count_range_* константного контейнера против
+// позиций в эталоне: i-й элемент, его ранг и число элементов между
+// соседними ключами и по краям.
+template <class Map, class Left, class Right>
+void compare_order_statistics(Map const &map, reference<Left, Right> const &ref,
+                              char const *name) {
+    bool ok = map.nth_left(ref.left_to_right.size()) == map.end_left();
+    size_t i = 0;
+    for (auto const &[left, right] : ref.left_to_right) {
+        auto it = map.nth_left(i);
+        if (it == map.end_left() || !(*it == left) || map.rank_left(left) != i ||
+            map.count_range_left(ref.left_to_right.begin()->first, left) != i) {
+            ok = false;
+            break;
+        }
+        ++i;
+    }
+    expect(ok, name, "nth_left or rank_left differs from std::map");
+    ok = true;
+    i = 0;
+    for (auto const &[right, left] : ref.right_to_left) {
+        if (map.count_range_right(ref.right_to_left.begin()->first, right) != i ||
+            map.count_range_right(right, right) != 0) {
+            ok = false;
+            break;
+        }
+        ++i;
+    }
+    expect(ok, name, "count_range_right differs from std::map");
+}
+
+// Позиция lower_bound(key) в упорядоченной стороне эталона.
+template <class Side, class Key> size_t reference_rank(Side const &side, Key const &key) {
+    return static_cast<size_t>(std::distance(side.begin(), side.lower_bound(key)));
+}
+
+// Случайные nth_*, rank_* и count_range_* между изменениями: неконстантные
+// перегрузки (в splay-дереве поднимают пройденный узел в корень) против
+// эталона, константные -- против неконстантных.
+template <class Map, class Left, class Right>
+void query_order_statistics(Map &map, reference<Left, Right> const &ref, std::mt19937 &rng,
+                            unsigned domain, char const *name) {
+    Map const &view = map;
+    size_t const k = rng() % (ref.left_to_right.size() + 2);
+    Left const left = make_key<Left>(rng() % domain);
+    Left const left_to = make_key<Left>(rng() % domain);
+    Right const right = make_key<Right>(rng() % domain);
+    Right const right_to = make_key<Right>(rng() % domain);
+
+    auto it = map.nth_left(k);
+    if (k < ref.left_to_right.size()) {
+        auto expected = std::next(ref.left_to_right.begin(), static_cast<long>(k));
+        expect(it != map.end_left() && *it == expected->first && *it.flip() == expected->second,
+               name, "nth_left");
+    } else {
+        expect(it == map.end_left(), name, "nth_left past the end");
+    }
+    expect(view.nth_left(k) == it, name, "const nth_left");
+
+    auto jt = map.nth_right(k);
+    if (k < ref.right_to_left.size()) {
+        auto expected = std::next(ref.right_to_left.begin(), static_cast<long>(k));
+        expect(jt != map.end_right() && *jt == expected->first && *jt.flip() == expected->second,
+               name, "nth_right");
+    } else {
+        expect(jt == map.end_right(), name, "nth_right past the end");
+    }
+    expect(view.nth_right(k) == jt, name, "const nth_right");
+
+    size_t const left_rank = reference_rank(ref.left_to_right, left);
+    size_t const left_to_rank = reference_rank(ref.left_to_right, left_to);
+    expect(map.rank_left(left) == left_rank, name, "rank_left");
+    expect(view.rank_left(left) == left_rank, name, "const rank_left");
+    size_t const left_count = left_to_rank > left_rank ? left_to_rank - left_rank : 0;
+    expect(map.count_range_left(left, left_to) == left_count, name, "count_range_left");
+    expect(view.count_range_left(left, left_to) == left_count, name, "const count_range_left");
+
+    size_t const right_rank = reference_rank(ref.right_to_left, right);
+    size_t const right_to_rank = reference_rank(ref.right_to_left, right_to);
+    expect(map.rank_right(right) == right_rank, name, "rank_right");
+    expect(view.rank_right(right) == right_rank, name, "const rank_right");
+    size_t const right_count = right_to_rank > right_rank ? right_to_rank - right_rank : 0;
+    expect(map.count_range_right(right, right_to) == right_count, name, "count_range_right");
+    expect(view.count_range_right(right, right_to) == right_count, name,
+           "const count_range_right");
+}
+
+// Случайные insert, erase_* по ключу и по итератору, find и lower_bound на
+// ключах из domain значений (у хешированной left вместо lower_bound --
+// find без удаления); каждые check_period шагов -- полное
+// сравнение и проверка копии. С order_statistics каждый четвертый шаг
+// добавляет случайные запросы порядковых статистик, а полное сравнение
+// проверяет и их.
+template <class Map>
+void random_operations(Map &map, char const *name, unsigned seed, unsigned domain,
+                       int steps) {
+    using left_t = typename Map::left_t;
+    using right_t = typename Map::right_t;
+    reference<left_t, right_t> ref;
+    std::mt19937 rng(seed);
+    int const check_period = steps / 20;
+    for (int step = 0; step < steps; ++step) {
+        left_t left = make_key<left_t>(rng() % domain);
+        right_t right = make_key<right_t>(rng() % domain);
+        switch (rng() % 8) {
+        case 0:
+        case 1:
+        case 2: {
+            // end_left() берется после вставки: у flat_bimap он зависит от size().
+            auto it = map.insert(left, right);
+            bool inserted = it != map.end_left();
+            expect(inserted == ref.insert(left, right), name, "insert result");
+            break;
+        }
+        case 3:
+            expect(map.erase_left(left) == ref.erase_left(left), name, "erase_left result");
+            break;
+        case 4:
+            expect(map.erase_right(right) == ref.erase_right(right), name,
+                   "erase_right result");
+            break;
+        case 5: {
+            auto it = map.find_left(left);
+            bool found = ref.left_to_right.count(left) != 0;
+            expect((it != map.end_left()) == found, name, "find_left");
+            if (found) {
+                ref.erase_left(left);
+                map.erase_left(it);
+            }
+            break;
+        }
+        case 6: {
+            if constexpr (hashed_sides<Map>::left) {
+                auto it = map.find_left(left);
+                expect((it != map.end_left()) == (ref.left_to_right.count(left) != 0), name,
+                       "find_left");
+            } else {
+                auto it = map.lower_bound_left(left);
+                auto expected = ref.left_to_right.lower_bound(left);
+                expect(expected == ref.left_to_right.end() ? it == map.end_left()
+                                                           : it != map.end_left() &&
+                                                                     *it == expected->first,
+                       name, "lower_bound_left");
+            }
+            break;
+        }
+        default: {
+            auto it = map.find_right(right);
+            bool found = ref.right_to_left.count(right) != 0;
+            expect((it != map.end_right()) == found, name, "find_right");
+            if (found) {
+                ref.erase_right(right);
+                map.erase_right(it);
+            }
+            break;
+        }
+        }
+        if constexpr (with_order_statistics<Map>::value) {
+            if (step % 4 == 0) {
+                query_order_statistics(map, ref, rng, domain, name);
+            }
+        }
+        if (step % check_period == 0) {
+            compare(map, ref, name);
+            if constexpr (with_order_statistics<Map>::value) {
+                compare_order_statistics(std::as_const(map), ref, name);
+            }
+            Map copy(map);
+            expect(copy == map, name, "copy differs");
+        }
+    }
+    compare(map, ref, name);
+}
+
+// Ресурс, считающий живые выделения.
+struct counting_resource : std::pmr::memory_resource {
+    long live = 0;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++live;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        --live;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(memory_resource const &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// polymorphic_allocator не распространяется: после присваивания и swap
+// контейнер остается на своем ресурсе, память другого ресурса не
+// занимается и не освобождается чужим контейнером.
+template <class Map> void pmr_resources(char const *name) {
+    using left_t = typename Map::left_t;
+    using right_t = typename Map::right_t;
+    counting_resource first;
+    counting_resource second;
+    {
+        Map a(&first);
+        Map b(&second);
+        reference<left_t, right_t> ref;
+        for (unsigned i = 0; i < 3000; ++i) {
+            a.insert(make_key<left_t>(i), make_key<right_t>(i + 1));
+            b.insert(make_key<left_t>(2 * i), make_key<right_t>(3 * i));
+            ref.insert(make_key<left_t>(2 * i), make_key<right_t>(3 * i));
+        }
+        for (unsigned i = 0; i < 3000; i += 3) {
+            a.erase_left(make_key<left_t>(i));
+        }
+        long const second_live = second.live;
+        a = std::move(b);
+        expect(a.get_allocator().resource() == &first, name,
+               "move assignment changed the resource");
+        expect(second.live == second_live, name,
+               "move assignment across resources touched the source resource");
+        compare(a, ref, name);
+
+        Map c(&second);
+        c = a;
+        expect(c.get_allocator().resource() == &second, name,
+               "copy assignment changed the resource");
+        expect(c == a, name, "copy assignment across resources");
+
+        Map d(&first);
+        d.insert(make_key<left_t>(1), make_key<right_t>(1));
+        swap(a, d);
+        expect(a.size() == 1 && d.size() == ref.left_to_right.size(), name, "swap");
+        compare(d, ref, name);
+    }
+    expect(first.live == 0 && second.live == 0, name, "memory left in a resource");
+}
+
+// Переносы узлов между тремя bimap: extract_*, insert(node_handle &&) и
+// merge против тех же переносов в эталонах. node_handle, не вставленный
+// из-за конфликта, возвращается и кладется обратно в источник. Время от
+// времени bimap заменяется новым: узлы, перевешенные из него, должны
+// пережить его пул.
+void node_transfers() {
+    using map_type = bimap<std::string, int>;
+    char const *name = "bimap node handles";
+    std::vector<map_type> maps(3);
+    std::vector<reference<std::string, int>> refs(3);
+    std::mt19937 rng(21);
+    for (int step = 0; step < 40000; ++step) {
+        size_t const from = rng() % 3;
+        size_t const to = rng() % 3;
+        std::string left = make_key<std::string>(rng() % 2000);
+        int right = static_cast<int>(rng() % 2000);
+        unsigned const op = rng() % 16;
+        if (op < 6) {
+            auto it = maps[from].insert(left, right);
+            bool inserted = it != maps[from].end_left();
+            expect(inserted == refs[from].insert(left, right), name, "insert result");
+        } else if (op < 8) {
+            expect(maps[from].erase_left(left) == refs[from].erase_left(left), name,
+                   "erase_left result");
+        } else if (op < 14) {
+            auto handle = op < 11 ? maps[from].extract_left(left)
+                                  : maps[from].extract_right(right);
+            auto found = op < 11 ? refs[from].left_to_right.find(left)
+                                 : refs[from].left_to_right.end();
+            if (op >= 11) {
+                auto by_right = refs[from].right_to_left.find(right);
+                if (by_right != refs[from].right_to_left.end()) {
+                    found = refs[from].left_to_right.find(by_right->second);
+                }
+            }
+            expect(handle.empty() == (found == refs[from].left_to_right.end()), name,
+                   "extract of a missing key");
+            if (handle.empty()) {
+                continue;
+            }
+            std::string const moved_left = found->first;
+            int const moved_right = found->second;
+            expect(handle.left() == moved_left && handle.right() == moved_right, name,
+                   "extracted values");
+            refs[from].erase_left(moved_left);
+            auto result = maps[to].insert(std::move(handle));
+            expect(handle.empty(), name, "inserted handle is not empty");
+            bool const inserted = refs[to].insert(moved_left, moved_right);
+            expect(result.inserted == inserted, name, "insert(node_handle) result");
+            if (!inserted) {
+                expect(!result.node.empty() && result.node.left() == moved_left &&
+                               result.node.right() == moved_right,
+                       name, "conflicting handle not returned");
+                expect(result.position != maps[to].end_left() &&
+                               (*result.position == moved_left ||
+                                *result.position.flip() == moved_right),
+                       name, "conflict position");
+                auto back = maps[from].insert(std::move(result.node));
+                expect(back.inserted, name, "reinsert into the source");
+                refs[from].insert(moved_left, moved_right);
+            }
+        } else if (op == 14) {
+            maps[to].merge(maps[from]);
+            if (from != to) {
+                for (auto it = refs[from].left_to_right.begin();
+                     it != refs[from].left_to_right.end();) {
+                    auto next = std::next(it);
+                    if (refs[to].insert(it->first, it->second)) {
+                        refs[from].erase_left(it->first);
+                    }
+                    it = next;
+                }
+            }
+        } else if (rng() % 8 == 0) {
+            maps[from] = map_type();
+            refs[from] = reference<std::string, int>();
+        }
+        if (step % 2000 == 0) {
+            for (size_t i = 0; i < 3; ++i) {
+                compare(maps[i], refs[i], name);
+            }
+        }
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        compare(maps[i], refs[i], name);
+    }
+
+    // node_handle переживает bimap и его пул.
+    map_type target;
+    {
+        map_type source;
+        source.insert(make_key<std::string>(1), 1);
+        auto handle = source.extract_left(make_key<std::string>(1));
+        source = map_type();
+        target.insert(std::move(handle));
+    }
+    expect(target.size() == 1 && target.at_left(make_key<std::string>(1)) == 1, name,
+           "handle outlived its bimap");
+
+    // Чужая арена держится, пока в пуле есть ее узлы.
+    map_type live;
+    for (unsigned i = 0; i < 100; ++i) {
+        live.insert(make_key<std::string>(i), static_cast<int>(i));
+    }
+    size_t const own = live.memory_usage();
+    for (unsigned c = 0; c < 20; ++c) {
+        map_type staging;
+        for (unsigned i = 0; i < 5000; ++i) {
+            staging.insert(make_key<std::string>(100000 * (c + 1) + i),
+                           static_cast<int>(100000 * (c + 1) + i));
+        }
+        live.insert(staging.extract_left(make_key<std::string>(100000 * (c + 1))));
+    }
+    expect(live.memory_usage() > own + 20 * 5000 * sizeof(int), name,
+           "foreign nodes were copied instead of relinked");
+    for (unsigned c = 0; c < 20; ++c) {
+        live.erase_left(make_key<std::string>(100000 * (c + 1)));
+    }
+    expect(live.memory_usage() < own + 4096, name, "foreign arenas outlived their nodes");
+}
+
+// Переносы между bimap на разных ресурсах: аллокаторы не равны, поэтому
+// значения перемещаются в узлы получателя, а узлы источника
+// разрушаются. Память каждого ресурса возвращается полностью.
+void pmr_node_transfers() {
+    using map_type = bimap<std::string, int, std::less<std::string>, std::less<int>,
+                           std::pmr::polymorphic_allocator<std::pair<std::string, int>>>;
+    char const *name = "bimap pmr node handles";
+    counting_resource first;
+    counting_resource second;
+    {
+        map_type a(&first);
+        map_type b(&second);
+        reference<std::string, int> ref_a;
+        reference<std::string, int> ref_b;
+        for (unsigned i = 0; i < 2000; ++i) {
+            a.insert(make_key<std::string>(i), static_cast<int>(i));
+            ref_a.insert(make_key<std::string>(i), static_cast<int>(i));
+        }
+        for (unsigned i = 0; i < 2000; i += 2) {
+            auto result = b.insert(a.extract_left(make_key<std::string>(i)));
+            expect(result.inserted, name, "insert(node_handle) across resources");
+            ref_a.erase_left(make_key<std::string>(i));
+            ref_b.insert(make_key<std::string>(i), static_cast<int>(i));
+        }
+        b.insert(make_key<std::string>(5000), 1);
+        ref_b.insert(make_key<std::string>(5000), 1);
+        b.merge(a);
+        ref_a.erase_left(make_key<std::string>(1));
+        for (auto const &[left, right] : ref_a.left_to_right) {
+            ref_b.insert(left, right);
+        }
+        ref_a = reference<std::string, int>();
+        ref_a.insert(make_key<std::string>(1), 1);
+        compare(a, ref_a, name);
+        compare(b, ref_b, name);
+        expect(b.get_allocator().resource() == &second, name, "merge changed the resource");
+    }
+    expect(first.live == 0 && second.live == 0, name, "memory left in a resource");
+}
+
+// Компаратор, бросающий после заданного числа вызовов (отрицательное --
+// никогда).
+long compare_budget = -1;
+
+template <class T> struct throwing_less {
+    bool operator()(T const &a, T const &b) const {
+        if (compare_budget == 0) {
+            throw std::runtime_error("throwing_less");
+        }
+        if (compare_budget > 0) {
+            --compare_budget;
+        }
+        return a < b;
+    }
+};
+
+// Вставки и удаления со случайно брошенным компаратором: брошенная
+// операция не меняет содержимое.
+template <class Map> void throwing_compare(char const *name, unsigned seed) {
+    using left_t = typename Map::left_t;
+    using right_t = typename Map::right_t;
+    Map map;
+    reference<left_t, right_t> ref;
+    std::mt19937 rng(seed);
+    int thrown = 0;
+    for (int step = 0; step < 20000; ++step) {
+        left_t left = make_key<left_t>(rng() % 2000);
+        right_t right = make_key<right_t>(rng() % 2000);
+        unsigned op = rng() % 3;
+        compare_budget = rng() % 2 == 0 ? static_cast<long>(rng() % 40) : -1;
+        try {
+            if (op == 0) {
+                if (map.erase_left(left)) {
+                    ref.erase_left(left);
+                }
+            } else {
+                auto it = map.insert(left, right);
+                if (it != map.end_left()) {
+                    ref.insert(left, right);
+                }
+            }
+        } catch (std::runtime_error const &) {
+            ++thrown;
+        }
+        compare_budget = -1;
+        if (step % 1000 == 0) {
+            compare(map, ref, name);
+        }
+    }
+    compare(map, ref, name);
+    expect(thrown > 0, name, "comparator never threw");
+}
+
+// at_left_or_default и at_right_or_default со случайно брошенным
+// компаратором против эталона: если ключа нет, пара со значением по
+// умолчанию на другой стороне получает этот ключ, а без такой пары
+// вставляется новая. Брошенный вызов не меняет содержимое.
+template <class Map> void throwing_or_default(char const *name, unsigned seed) {
+    using left_t = typename Map::left_t;
+    using right_t = typename Map::right_t;
+    Map map;
+    reference<left_t, right_t> ref;
+    std::mt19937 rng(seed);
+    int thrown = 0;
+    for (int step = 0; step < 20000; ++step) {
+        left_t left = make_key<left_t>(rng() % 500);
+        right_t right = make_key<right_t>(rng() % 500);
+        unsigned const op = rng() % 4;
+        compare_budget = rng() % 2 == 0 ? static_cast<long>(rng() % 30) : -1;
+        try {
+            if (op == 0) {
+                auto it = map.insert(left, right);
+                if (it != map.end_left()) {
+                    ref.insert(left, right);
+                }
+            } else if (op == 1) {
+                right_t const got = map.at_left_or_default(left);
+                compare_budget = -1;
+                auto found = ref.left_to_right.find(left);
+                if (found != ref.left_to_right.end()) {
+                    expect(got == found->second, name, "at_left_or_default of a present key");
+                } else {
+                    expect(got == right_t{}, name, "at_left_or_default of a missing key");
+                    ref.erase_right(right_t{});
+                    ref.insert(left, right_t{});
+                }
+            } else if (op == 2) {
+                left_t const got = map.at_right_or_default(right);
+                compare_budget = -1;
+                auto found = ref.right_to_left.find(right);
+                if (found != ref.right_to_left.end()) {
+                    expect(got == found->second, name, "at_right_or_default of a present key");
+                } else {
+                    expect(got == left_t{}, name, "at_right_or_default of a missing key");
+                    ref.erase_left(left_t{});
+                    ref.insert(left_t{}, right);
+                }
+            } else if (map.erase_left(left)) {
+                ref.erase_left(left);
+            }
+        } catch (std::runtime_error const &) {
+            ++thrown;
+        }
+        compare_budget = -1;
+        if (step % 500 == 0) {
+            compare(map, ref, name);
+        }
+    }
+    compare(map, ref, name);
+    expect(thrown > 0, name, "comparator never threw");
+}
+
+// Значение, считающее живые экземпляры: утечку значений видно и без
+// санитайзера.
+struct tracked {
+    explicit tracked(int value) : value(value) { ++live; }
+    tracked(tracked const &other) : value(other.value) { ++live; }
+    tracked &operator=(tracked const &) = default;
+    ~tracked() { --live; }
+
+    friend bool operator<(tracked const &a, tracked const &b) { return a.value < b.value; }
+    friend bool operator==(tracked const &a, tracked const &b) { return a.value == b.value; }
+    friend bool operator!=(tracked const &a, tracked const &b) { return a.value != b.value; }
+
+    int value;
+    static inline long live = 0;
+};
+
+// intersect с компаратором, бросающим на разных шагах обоих слияний:
+// копии общих пар, еще не попавшие в деревья, разрушаются.
+void throwing_intersect() {
+    using map_type = bimap<tracked, tracked, throwing_less<tracked>, throwing_less<tracked>>;
+    char const *name = "bimap intersect throwing";
+    {
+        map_type a;
+        map_type b;
+        for (int i = 0; i < 300; ++i) {
+            a.insert(tracked(i), tracked(1000 - i));
+            b.insert(tracked(i), tracked(i % 3 == 0 ? 1000 - i : 2000 + i));
+        }
+        long const live = tracked::live;
+        int thrown = 0;
+        for (long budget = 0; budget < 4000; budget += 7) {
+            compare_budget = budget;
+            try {
+                map_type common = intersect(a, b);
+                compare_budget = -1;
+                expect(common.size() == 100, name, "size of the intersection");
+            } catch (std::runtime_error const &) {
+                ++thrown;
+            }
+            compare_budget = -1;
+            expect(tracked::live == live, name, "values leaked after a throw");
+        }
+        expect(thrown > 0, name, "comparator never threw");
+    }
+    expect(tracked::live == 0, name, "values left after destruction");
+}
+
+// То же для insert_range: брошенная массовая вставка не вставляет ничего.
+// По мере роста map маленькие пачки переходят на поэлементную вставку.
+template <class Map> void throwing_compare_bulk(char const *name) {
+    Map map;
+    reference<std::string, int> ref;
+    std::mt19937 rng(5);
+    int thrown = 0;
+    for (int step = 0; step < 2000; ++step) {
+        std::vector<std::pair<std::string, int>> batch;
+        for (int i = 0; i < 20; ++i) {
+            batch.emplace_back(make_key<std::string>(rng() % 5000), static_cast<int>(rng() % 5000));
+        }
+        compare_budget = rng() % 2 == 0 ? static_cast<long>(rng() % 400) : -1;
+        try {
+            map.insert_range(batch.begin(), batch.end());
+            compare_budget = -1;
+            for (auto const &[left, right] : batch) {
+                ref.insert(left, right);
+            }
+        } catch (std::runtime_error const &) {
+            ++thrown;
+        }
+        compare_budget = -1;
+        if (step % 100 == 0) {
+            compare(map, ref, name);
+        }
+    }
+    compare(map, ref, name);
+    expect(thrown > 0, name, "comparator never threw");
+}
+
+// Аллокатор, бросающий std::bad_alloc после заданного числа выделений.
+long allocation_budget = -1;
+
+template <class T> struct failing_allocator {
+    using value_type = T;
+
+    failing_allocator() = default;
+    template <class U> failing_allocator(failing_allocator<U> const &) {}
+
+    T *allocate(std::size_t n) {
+        if (allocation_budget == 0) {
+            throw std::bad_alloc();
+        }
+        if (allocation_budget > 0) {
+            --allocation_budget;
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) { std::allocator<T>().deallocate(p, n); }
+
+    friend bool operator==(failing_allocator const &, failing_allocator const &) { return true; }
+    friend bool operator!=(failing_allocator const &, failing_allocator const &) { return false; }
+};
+
+// Вставки в btree_bimap с отказами аллокатора при расщеплении узлов.
+void failing_allocations() {
+    using map_type = btree_bimap<int, int, failing_allocator<std::pair<int, int>>>;
+    char const *name = "btree_bimap bad_alloc";
+    map_type map;
+    reference<int, int> ref;
+    std::mt19937 rng(9);
+    int thrown = 0;
+    for (int step = 0; step < 100000; ++step) {
+        int left = static_cast<int>(rng() % 20000);
+        int right = static_cast<int>(rng() % 20000);
+        if (rng() % 3 == 0) {
+            expect(map.erase_left(left) == ref.erase_left(left), name, "erase_left result");
+            continue;
+        }
+        allocation_budget = rng() % 4 == 0 ? static_cast<long>(rng() % 3) : -1;
+        try {
+            auto it = map.insert(left, right);
+            allocation_budget = -1;
+            bool inserted = it != map.end_left();
+            expect(inserted == ref.insert(left, right), name, "insert result");
+        } catch (std::bad_alloc const &) {
+            ++thrown;
+        }
+        allocation_budget = -1;
+        if (step % 10000 == 0) {
+            compare(map, ref, name);
+        }
+    }
+    compare(map, ref, name);
+    expect(thrown > 0, name, "allocator never threw");
+
+    // Отказ при первой вставке в пустое дерево.
+    map_type empty;
+    allocation_budget = 1;
+    try {
+        empty.insert(1, 2);
+    } catch (std::bad_alloc const &) {
+    }
+    allocation_budget = -1;
+    expect(empty.empty() && empty.begin_left() == empty.end_left(), name,
+           "failed first insert left pairs behind");
+    expect(empty.insert(1, 2) != empty.end_left() && empty.at_left(1) == 2, name,
+           "insert after a failed first insert");
+}
+
+// concurrent_bimap: в одном потоке -- против эталона, в нескольких --
+// согласованность сторон после конкурентных изменений.
+template <class Map> void concurrent_operations(char const *name, size_t shards) {
+    {
+        Map map(shards);
+        reference<int, int> ref;
+        std::mt19937 rng(11);
+        for (int step = 0; step < 50000; ++step) {
+            int left = static_cast<int>(rng() % 500);
+            int right = static_cast<int>(rng() % 500);
+            switch (rng() % 4) {
+            case 0:
+            case 1:
+                expect(map.insert(left, right) == ref.insert(left, right), name, "insert result");
+                break;
+            case 2:
+                expect(map.erase_left(left) == ref.erase_left(left), name, "erase_left result");
+                break;
+            default:
+                expect(map.erase_right(right) == ref.erase_right(right), name,
+                       "erase_right result");
+                break;
+            }
+        }
+        expect(map.size() == ref.left_to_right.size(), name, "size");
+        bool ok = true;
+        for (int key = 0; key < 500; ++key) {
+            auto right = map.find_left(key);
+            auto expected = ref.left_to_right.find(key);
+            ok = ok && (expected == ref.left_to_right.end() ? !right
+                                                             : right && *right == expected->second);
+        }
+        expect(ok, name, "find_left differs from std::map");
+    }
+    Map map(shards);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; ++t) {
+        threads.emplace_back([&map, t] {
+            std::mt19937 rng(t);
+            for (int i = 0; i < 20000; ++i) {
+                int left = static_cast<int>(rng() % 300);
+                int right = static_cast<int>(rng() % 300);
+                switch (rng() % 4) {
+                case 0:
+                case 1:
+                    map.insert(left, right);
+                    break;
+                case 2:
+                    map.erase_left(left);
+                    break;
+                default:
+                    map.erase_right(right);
+                    break;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    size_t pairs = 0;
+    bool ok = true;
+    for (int left = 0; left < 300; ++left) {
+        if (auto right = map.find_left(left)) {
+            ++pairs;
+            auto back = map.find_right(*right);
+            ok = ok && back && *back == left;
+        }
+    }
+    expect(ok, name, "sides disagree after concurrent updates");
+    expect(pairs == map.size(), name, "size after concurrent updates");
+}
+
+// Бросающий компаратор в шардах concurrent_bimap: брошенная операция не
+// оставляет пару в одном шарде без копии в другом.
+void concurrent_throwing_compare() {
+    using map_type = concurrent_bimap<int, int, throwing_less<int>, throwing_less<int>>;
+    char const *name = "concurrent_bimap throwing";
+    map_type map(8);
+    reference<int, int> ref;
+    std::mt19937 rng(13);
+    int thrown = 0;
+    for (int step = 0; step < 20000; ++step) {
+        int left = static_cast<int>(rng() % 1000);
+        int right = static_cast<int>(rng() % 1000);
+        unsigned op = rng() % 3;
+        compare_budget = rng() % 2 == 0 ? static_cast<long>(rng() % 30) : -1;
+        try {
+            if (op == 0) {
+                if (map.erase_left(left)) {
+                    ref.erase_left(left);
+                }
+            } else if (op == 1) {
+                if (map.erase_right(right)) {
+                    ref.erase_right(right);
+                }
+            } else if (map.insert(left, right)) {
+                ref.insert(left, right);
+            }
+        } catch (std::runtime_error const &) {
+            ++thrown;
+        }
+        compare_budget = -1;
+    }
+    expect(thrown > 0, name, "comparator never threw");
+    expect(map.size() == ref.left_to_right.size(), name, "size");
+    bool ok = true;
+    for (int key = 0; key < 1000; ++key) {
+        auto right = map.find_left(key);
+        auto expected_right = ref.left_to_right.find(key);
+        ok = ok && (expected_right == ref.left_to_right.end()
+                            ? !right
+                            : right && *right == expected_right->second);
+        auto left = map.find_right(key);
+        auto expected_left = ref.right_to_left.find(key);
+        ok = ok && (expected_left == ref.right_to_left.end()
+                            ? !left
+                            : left && *left == expected_left->second);
+    }
+    expect(ok, name, "contents differ from std::map");
+}
+
+// operator== сверяет пары, а не стороны по отдельности: у {(1, 2), (2, 1)}
+// и {(1, 1), (2, 2)} одинаковые множества left и right.
+template <class Map> void crossed_pairs(char const *name) {
+    Map crossed;
+    crossed.insert(1, 2);
+    crossed.insert(2, 1);
+    Map straight;
+    straight.insert(1, 1);
+    straight.insert(2, 2);
+    expect(!(crossed == straight) && crossed != straight, name, "crossed pairs compare equal");
+    Map copy(crossed);
+    expect(copy == crossed, name, "copy differs");
+}
+
+// Случайные a и b на общих ключах: diff(a, b) содержит удаления, новые
+// пары и смену right, в том числе right, переходящие между парами, и
+// apply на a дает b. На другом bimap apply сообщает о несовпадении.
+void diff_apply() {
+    using map_type = bimap<std::string, int>;
+    char const *name = "bimap diff/apply";
+    std::mt19937 rng(25);
+    for (int round = 0; round < 200; ++round) {
+        unsigned const domain = 1 + rng() % 300;
+        map_type a;
+        map_type b;
+        for (unsigned i = 0; i < domain; ++i) {
+            a.insert(make_key<std::string>(rng() % domain), static_cast<int>(rng() % domain));
+            b.insert(make_key<std::string>(rng() % domain), static_cast<int>(rng() % domain));
+        }
+        auto delta = diff(a, b);
+        expect(delta.empty() == (a == b), name, "empty diff of different maps");
+        map_type target(a);
+        expect(target.apply(delta), name, "apply to the source reported a mismatch");
+        expect(target == b, name, "apply(diff(a, b)) to a differs from b");
+        expect(diff(target, b).empty(), name, "diff after apply is not empty");
+    }
+
+    map_type a;
+    map_type b;
+    for (int i = 0; i < 10; ++i) {
+        a.insert(make_key<std::string>(i), i);
+        b.insert(make_key<std::string>(i + 5), i == 7 ? 100 : i + 5);
+    }
+    auto const delta = diff(a, b);
+    {
+        // Удаляемой пары нет.
+        map_type target(a);
+        target.erase_left(make_key<std::string>(0));
+        expect(!target.apply(delta), name, "missing removed pair not reported");
+    }
+    {
+        // Удаляемый left парен другому right.
+        map_type target(a);
+        target.erase_left(make_key<std::string>(1));
+        target.insert(make_key<std::string>(1), 1000);
+        expect(!target.apply(delta), name, "removed left with another right not reported");
+    }
+    {
+        // Добавляемый right уже занят.
+        map_type target(a);
+        target.insert(make_key<std::string>(1000), 100);
+        expect(!target.apply(delta), name, "conflicting added pair not reported");
+        expect(target.find_right(100) != target.end_right() &&
+                       *target.find_right(100).flip() == make_key<std::string>(1000),
+               name, "conflicting pair replaced");
+    }
+    {
+        map_type target(a);
+        expect(target.apply(delta) && target == b, name, "apply to the source");
+        expect(!target.apply(delta), name, "second apply not reported");
+    }
+}
+
+// Снимки mapped_bimap.cpp лежат во временном каталоге.
+std::string snapshot_path(char const *file) {
+    return (std::filesystem::temp_directory_path() / file).string();
+}
+
+std::vector<char> read_file(std::string const &path) {
+    std::vector<char> bytes;
+    if (std::FILE *file = std::fopen(path.c_str(), "rb")) {
+        char buffer[4096];
+        for (size_t got; (got = std::fread(buffer, 1, sizeof(buffer), file)) != 0;) {
+            bytes.insert(bytes.end(), buffer, buffer + got);
+        }
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+void write_file(std::string const &path, std::vector<char> const &bytes) {
+    if (std::FILE *file = std::fopen(path.c_str(), "wb")) {
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
+}
+
+// Сериализатор std::string: байты строки без завершающего нуля.
+struct string_serializer {
+    static size_t size(std::string const &value) { return value.size(); }
+    static void write(std::string const &value, char *out) {
+        std::memcpy(out, value.data(), value.size());
+    }
+    static std::string read(char const *in, size_t size) { return std::string(in, size); }
+};
+
+// Заполняет map и эталон случайными парами.
+template <class Map, class Left, class Right>
+void fill(Map &map, reference<Left, Right> &ref, unsigned seed, unsigned count) {
+    std::mt19937 rng(seed);
+    for (unsigned i = 0; i < count; ++i) {
+        Left left = make_key<Left>(rng() % (count * 4));
+        Right right = make_key<Right>(rng() % (count * 4));
+        auto it = map.insert(left, right);
+        bool inserted = it != map.end_left();
+        expect(inserted == ref.insert(left, right), "snapshot source", "insert result");
+    }
+}
+
+// save_bimap, затем mapped_bimap и load_bimap в каждый контейнер против
+// эталона: обе стороны, поиск в обе стороны и verify().
+void snapshot_round_trip() {
+    std::string const path = snapshot_path("bimap_tests.snapshot");
+    {
+        bimap<int, int> source;
+        reference<int, int> ref;
+        fill(source, ref, 22, 5000);
+        save_bimap(source, path);
+        mapped_bimap<int, int> mapped(path);
+        expect(mapped.verify(), "mapped_bimap", "verify of a fresh snapshot");
+        compare(mapped, ref, "mapped_bimap");
+        compare(load_bimap<bimap<int, int>>(path), ref, "load_bimap bimap");
+        compare(load_bimap<flat_bimap<int, int>>(path), ref, "load_bimap flat_bimap");
+        compare(load_bimap<btree_bimap<int, int>>(path), ref, "load_bimap btree_bimap");
+        compare(load_bimap<compact_bimap<int, int>>(path), ref, "load_bimap compact_bimap");
+    }
+    {
+        bimap<int, int> source;
+        save_bimap(source, path);
+        mapped_bimap<int, int> mapped(path);
+        expect(mapped.verify() && mapped.empty(), "mapped_bimap empty", "empty snapshot");
+        expect(load_bimap<flat_bimap<int, int>>(path).size() == 0, "load_bimap empty",
+               "empty snapshot");
+    }
+    {
+        bimap<std::string, int> source;
+        reference<std::string, int> ref;
+        fill(source, ref, 23, 3000);
+        save_bimap<string_serializer>(source, path);
+        mapped_bimap<std::string, int, std::less<std::string>, std::less<int>,
+                     string_serializer>
+                mapped(path);
+        expect(mapped.verify(), "mapped_bimap serializer", "verify of a fresh snapshot");
+        compare(mapped, ref, "mapped_bimap serializer");
+        compare(load_bimap<bimap<std::string, int>, string_serializer>(path), ref,
+                "load_bimap serializer bimap");
+        compare(load_bimap<flat_bimap<std::string, int>, string_serializer>(path), ref,
+                "load_bimap serializer flat_bimap");
+    }
+    std::remove(path.c_str());
+}
+
+// Открытие испорченного снимка bytes бросает std::runtime_error с what
+// в сообщении.
+void expect_rejected(std::vector<char> const &bytes, char const *what, char const *case_name) {
+    std::string const path = snapshot_path("bimap_tests.broken.snapshot");
+    write_file(path, bytes);
+    bool rejected = false;
+    try {
+        mapped_bimap<int, int> mapped(path);
+    } catch (std::runtime_error const &e) {
+        rejected = std::strstr(e.what(), what) != nullptr;
+    }
+    expect(rejected, "mapped_bimap rejects", case_name);
+    std::remove(path.c_str());
+}
+
+// Меняет заголовок снимка и пересчитывает его контрольную сумму, чтобы
+// сработала именно проверка измененного поля.
+template <class Change> std::vector<char> with_header(std::vector<char> bytes, Change change) {
+    snapshot_header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    change(header);
+    header.header_checksum = snapshot_detail::header_checksum(header);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+// Неверные magic, версия, контрольные суммы заголовка и данных, обрезанный
+// файл и секции за его границами.
+void snapshot_rejections() {
+    std::string const path = snapshot_path("bimap_tests.snapshot");
+    {
+        bimap<int, int> source;
+        reference<int, int> ref;
+        fill(source, ref, 24, 1000);
+        save_bimap(source, path);
+    }
+    std::vector<char> const good = read_file(path);
+    std::remove(path.c_str());
+    expect(good.size() > snapshot_detail::header_size, "mapped_bimap rejects", "snapshot size");
+
+    std::vector<char> bytes = good;
+    bytes[0] ^= 1;
+    expect_rejected(bytes, "not a bimap snapshot", "bad magic");
+
+    expect_rejected(with_header(good, [](snapshot_header &h) { h.version = snapshot_version + 1; }),
+                    "unsupported snapshot version", "bad version");
+
+    bytes = good;
+    bytes[offsetof(snapshot_header, count)] ^= 1;
+    expect_rejected(bytes, "corrupted snapshot header", "bad header checksum");
+
+    bytes = good;
+    bytes.resize(snapshot_detail::header_size / 2);
+    expect_rejected(bytes, "file too small", "file shorter than the header");
+
+    bytes = good;
+    bytes.resize(snapshot_detail::header_size + (good.size() - snapshot_detail::header_size) / 2);
+    expect_rejected(bytes, "corrupted snapshot header", "truncated sections");
+
+    expect_rejected(with_header(good,
+                                [&](snapshot_header &h) {
+                                    h.sections[snapshot_header::right_other].offset =
+                                            snapshot_detail::align_up(good.size());
+                                }),
+                    "corrupted snapshot header", "section starts past the end");
+    expect_rejected(with_header(good,
+                                [&](snapshot_header &h) {
+                                    h.sections[snapshot_header::left_other].size =
+                                            good.size();
+                                }),
+                    "corrupted snapshot header", "section ends past the end");
+    expect_rejected(with_header(good,
+                                [](snapshot_header &h) {
+                                    h.sections[snapshot_header::left_values].size = 0;
+                                }),
+                    "corrupted snapshot header", "section shorter than its values");
+    expect_rejected(with_header(good,
+                                [](snapshot_header &h) {
+                                    h.sections[snapshot_header::left_values].offset += 4;
+                                }),
+                    "corrupted snapshot header", "misaligned section");
+
+    // Данные заголовком не защищены: снимок открывается, verify() и
+    // load_bimap замечают повреждение.
+    bytes = good;
+    bytes[snapshot_detail::header_size] ^= 1;
+    write_file(path, bytes);
+    {
+        mapped_bimap<int, int> mapped(path);
+        expect(!mapped.verify(), "mapped_bimap rejects", "verify of a corrupted payload");
+    }
+    bool rejected = false;
+    try {
+        load_bimap<bimap<int, int>>(path);
+    } catch (std::runtime_error const &e) {
+        rejected = std::strstr(e.what(), "checksum mismatch") != nullptr;
+    }
+    expect(rejected, "load_bimap rejects", "corrupted payload");
+    std::remove(path.c_str());
+}
+
+template <class Left, class Right>
+using pmr_pair_allocator = std::pmr::polymorphic_allocator<std::pair<Left, Right>>;
+
+} // namespace
+
+int main() {
+    {
+        bimap<std::string, int> map;
+        random_operations(map, "bimap", 1, 3000, 60000);
+    }
+    {
+        bimap<std::string, int, std::less<std::string>, std::less<int>,
+              std::allocator<std::pair<std::string, int>>, red_black>
+                map;
+        random_operations(map, "bimap red_black", 16, 3000, 60000);
+    }
+    {
+        bimap<std::string, int, std::less<std::string>, std::less<int>,
+              std::allocator<std::pair<std::string, int>>, order_statistics>
+                map;
+        random_operations(map, "bimap order_statistics", 17, 3000, 60000);
+    }
+    {
+        bimap<std::string, int, std::less<std::string>, std::less<int>,
+              std::allocator<std::pair<std::string, int>>, red_black, order_statistics>
+                map;
+        random_operations(map, "bimap red_black order_statistics", 18, 3000, 60000);
+    }
+    {
+        bimap<std::string, int, std::less<std::string>, std::less<int>,
+              std::allocator<std::pair<std::string, int>>, order_statistics, splay_on_read<3>>
+                map;
+        random_operations(map, "bimap order_statistics splay_on_read", 19, 3000, 60000);
+    }
+    {
+        unordered_bimap<std::string, int> map;
+        random_operations(map, "unordered_bimap", 20, 3000, 60000);
+    }
+    {
+        bimap<std::string, int, hashed<>, std::less<int>> map;
+        random_operations(map, "bimap hashed/ordered", 21, 3000, 60000);
+    }
+    {
+        compact_bimap<std::string, int> map;
+        random_operations(map, "compact_bimap", 2, 3000, 60000);
+    }
+    {
+        flat_bimap<std::string, int> map;
+        random_operations(map, "flat_bimap", 3, 3000, 60000);
+    }
+    {
+        btree_bimap<int, int> map;
+        random_operations(map, "btree_bimap", 4, 30000, 200000);
+    }
+    {
+        btree_bimap<std::uint64_t, std::uint32_t> map;
+        random_operations(map, "btree_bimap<uint64_t, uint32_t>", 5, 30000, 200000);
+    }
+
+    pmr_resources<bimap<std::string, int, std::less<std::string>, std::less<int>,
+                        pmr_pair_allocator<std::string, int>>>("bimap pmr");
+    pmr_resources<compact_bimap<std::string, int, std::less<std::string>, std::less<int>,
+                                pmr_pair_allocator<std::string, int>>>("compact_bimap pmr");
+    pmr_resources<flat_bimap<std::string, int, std::less<std::string>, std::less<int>,
+                             pmr_pair_allocator<std::string, int>>>("flat_bimap pmr");
+    pmr_resources<btree_bimap<int, int, pmr_pair_allocator<int, int>>>("btree_bimap pmr");
+
+    node_transfers();
+    pmr_node_transfers();
+
+    throwing_compare<compact_bimap<std::string, int, throwing_less<std::string>,
+                                   throwing_less<int>>>("compact_bimap throwing", 6);
+    throwing_compare<flat_bimap<std::string, int, throwing_less<std::string>,
+                                throwing_less<int>>>("flat_bimap throwing", 7);
+    throwing_compare_bulk<flat_bimap<std::string, int, throwing_less<std::string>,
+                                     throwing_less<int>>>("flat_bimap insert_range");
+    throwing_compare_bulk<bimap<std::string, int, throwing_less<std::string>,
+                                throwing_less<int>>>("bimap insert_range");
+    throwing_or_default<bimap<std::string, int, throwing_less<std::string>,
+                              throwing_less<int>>>("bimap or_default throwing", 15);
+    throwing_intersect();
+    failing_allocations();
+
+    concurrent_operations<concurrent_bimap<int, int>>("concurrent_bimap", 8);
+    concurrent_operations<concurrent_bimap<int, int, std::less<int>, std::less<int>>>(
+            "concurrent_bimap ordered", 8);
+    concurrent_operations<concurrent_bimap<int, int>>("concurrent_bimap one shard", 1);
+    concurrent_throwing_compare();
+
+    crossed_pairs<bimap<int, int>>("bimap ==");
+    crossed_pairs<unordered_bimap<int, int>>("unordered_bimap ==");
+    crossed_pairs<flat_bimap<int, int>>("flat_bimap ==");
+    crossed_pairs<btree_bimap<int, int>>("btree_bimap ==");
+    crossed_pairs<compact_bimap<int, int>>("compact_bimap ==");
+    diff_apply();
+
+    snapshot_round_trip();
+    snapshot_rejections();
+
+    if (failures != 0) {
+        std::printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::puts("all checks passed");
+}